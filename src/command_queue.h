@@ -0,0 +1,105 @@
+// Copyright (c) 2025 Anders Xiao. All rights reserved.
+// https://github.com/endink
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+enum class PlayerCommandType {
+	Play = 0,
+	Pause,
+	Seek,
+	Rate,
+	Reverse,
+	Scrub,
+	Close,
+};
+
+struct PlayerCommand {
+	PlayerCommandType Type = PlayerCommandType::Play;
+	int64_t Value = 0;     // Seek: 目标时间（AV_TIME_BASE 微秒）；Reverse / Scrub: 0/1
+	double Rate = 1.0;     // Rate: 播放速率
+	bool Accurate = false; // Seek: 解码到精确的目标帧，而不是停在之前的关键帧
+};
+
+/*
+  有界无锁 MPSC 命令队列（Vyukov 环形队列），控制 API 在任意线程投递，播放器工作线程消费。
+  投递只有几次原子操作，不会阻塞调用线程。
+*/
+struct CommandQueue {
+	static const size_t kCapacity = 64; // 必须是 2 的幂
+
+	struct Cell {
+		std::atomic<size_t> Sequence{ 0 };
+		PlayerCommand Command;
+	};
+
+	Cell cells[kCapacity];
+	std::atomic<size_t> enqueuePos{ 0 };
+	std::atomic<size_t> dequeuePos{ 0 };
+
+	CommandQueue() {
+		for (size_t i = 0; i < kCapacity; i++) {
+			cells[i].Sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	CommandQueue(const CommandQueue&) = delete;
+	CommandQueue& operator=(const CommandQueue&) = delete;
+
+	// 任意线程调用，队列满时返回 false
+	bool Push(const PlayerCommand& command) {
+		size_t pos = enqueuePos.load(std::memory_order_relaxed);
+		for (;;) {
+			Cell& cell = cells[pos & (kCapacity - 1)];
+			size_t seq = cell.Sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+			if (diff == 0) {
+				if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					cell.Command = command;
+					cell.Sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0) {
+				return false;
+			}
+			else {
+				pos = enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// 仅工作线程调用
+	bool Pop(PlayerCommand& command) {
+		size_t pos = dequeuePos.load(std::memory_order_relaxed);
+		Cell& cell = cells[pos & (kCapacity - 1)];
+		size_t seq = cell.Sequence.load(std::memory_order_acquire);
+		if ((intptr_t)seq - (intptr_t)(pos + 1) < 0) {
+			return false;
+		}
+		command = cell.Command;
+		cell.Sequence.store(pos + kCapacity, std::memory_order_release);
+		dequeuePos.store(pos + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// 仅工作线程调用：查看队首命令但不取出
+	bool Peek(PlayerCommand& command) const {
+		size_t pos = dequeuePos.load(std::memory_order_relaxed);
+		const Cell& cell = cells[pos & (kCapacity - 1)];
+		if ((intptr_t)cell.Sequence.load(std::memory_order_acquire) - (intptr_t)(pos + 1) < 0) {
+			return false;
+		}
+		command = cell.Command;
+		return true;
+	}
+
+	bool Empty() const {
+		size_t pos = dequeuePos.load(std::memory_order_relaxed);
+		const Cell& cell = cells[pos & (kCapacity - 1)];
+		return (intptr_t)cell.Sequence.load(std::memory_order_acquire) - (intptr_t)(pos + 1) < 0;
+	}
+};
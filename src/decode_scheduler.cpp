@@ -0,0 +1,240 @@
+// Copyright (c) 2025 Anders Xiao. All rights reserved.
+// https://github.com/endink
+
+#include "decode_scheduler.h"
+#include "commons.h"
+
+#include <algorithm>
+#include <chrono>
+
+static int64_t SchedulerNowUS()
+{
+	using namespace std::chrono;
+	return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+DecodeScheduler& DecodeScheduler::Shared()
+{
+	// 有意不析构：在 DLL 卸载 / 进程退出阶段 join 线程可能死锁
+	static DecodeScheduler* instance = new DecodeScheduler();
+	return *instance;
+}
+
+DecodeScheduler::~DecodeScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+		sleepCond.notify_all();
+	}
+	for (auto& worker : workers) {
+		if (worker->Thread.joinable()) worker->Thread.join();
+	}
+}
+
+bool DecodeScheduler::Configure(int threadCount)
+{
+	std::lock_guard<std::mutex> lock(startMutex);
+	if (started.load()) {
+		LogWarning("Decode scheduler already started with %d threads, configure ignored.", (int)workers.size());
+		return false;
+	}
+	requestedThreads = threadCount;
+	return true;
+}
+
+void DecodeScheduler::EnsureStarted()
+{
+	if (started.load()) return;
+
+	std::lock_guard<std::mutex> lock(startMutex);
+	if (started.load()) return;
+
+	int count = requestedThreads;
+	if (count <= 0) {
+		count = (int)std::thread::hardware_concurrency();
+	}
+	count = std::max(1, count);
+
+	for (int i = 0; i < count; i++) {
+		workers.push_back(std::make_unique<Worker>());
+	}
+	for (int i = 0; i < count; i++) {
+		workers[i]->Thread = std::thread(&DecodeScheduler::WorkerLoop, this, i);
+	}
+	started = true;
+	LogInfo("Decode scheduler started, threads: %d", count);
+}
+
+void DecodeScheduler::Add(ScheduledTask* task)
+{
+	if (!task) return;
+	EnsureStarted();
+
+	std::lock_guard<std::mutex> lock(task->Mutex);
+	task->Removed = false;
+	task->WakeRequested = false;
+	task->HomeWorker = (int)(nextWorker++ % workers.size());
+	Enqueue(task, SchedulerNowUS());
+}
+
+void DecodeScheduler::Remove(ScheduledTask* task)
+{
+	if (!task || !started.load()) return;
+
+	{
+		std::lock_guard<std::mutex> lock(task->Mutex);
+		task->Removed = true;
+		task->Generation++;
+	}
+
+	// 从所有堆中清除该任务的队列项，之后不会再有新的 InFlight
+	for (auto& worker : workers) {
+		std::lock_guard<std::mutex> lock(worker->Mutex);
+		auto& heap = worker->Heap;
+		auto it = std::remove_if(heap.begin(), heap.end(), [task](const Entry& e) { return e.Task == task; });
+		if (it != heap.end()) {
+			heap.erase(it, heap.end());
+			std::make_heap(heap.begin(), heap.end(), &DecodeScheduler::Later);
+		}
+	}
+
+	// 等待正在运行的时间片结束
+	for (;;) {
+		{
+			std::lock_guard<std::mutex> lock(task->Mutex);
+			if (!task->Running && task->InFlight.load() == 0) break;
+		}
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+}
+
+void DecodeScheduler::Wake(ScheduledTask* task)
+{
+	if (!task || !started.load()) return;
+
+	std::lock_guard<std::mutex> lock(task->Mutex);
+	if (task->Removed) return;
+	if (task->Running) {
+		task->WakeRequested = true;
+		return;
+	}
+	Enqueue(task, SchedulerNowUS());
+}
+
+// caller must hold task->Mutex
+void DecodeScheduler::Enqueue(ScheduledTask* task, int64_t deadline)
+{
+	uint64_t generation = ++task->Generation;
+	Worker& worker = *workers[task->HomeWorker];
+	{
+		std::lock_guard<std::mutex> lock(worker.Mutex);
+		worker.Heap.push_back(Entry{ deadline, task, generation });
+		std::push_heap(worker.Heap.begin(), worker.Heap.end(), &DecodeScheduler::Later);
+	}
+	// 空闲线程按所有堆中最早的截止时间睡眠，新的队列项可能更早，有线程在睡眠时唤醒它们重新计算
+	std::lock_guard<std::mutex> lock(sleepMutex);
+	enqueueSequence++;
+	if (sleepingWorkers > 0) {
+		sleepCond.notify_all();
+	}
+}
+
+bool DecodeScheduler::PopDue(Worker& worker, int64_t now, Entry& out)
+{
+	std::lock_guard<std::mutex> lock(worker.Mutex);
+	auto& heap = worker.Heap;
+	if (heap.empty() || heap.front().Deadline > now) {
+		return false;
+	}
+	std::pop_heap(heap.begin(), heap.end(), &DecodeScheduler::Later);
+	out = heap.back();
+	heap.pop_back();
+	out.Task->InFlight++;
+	return true;
+}
+
+int64_t DecodeScheduler::NextDeadline(Worker& worker)
+{
+	std::lock_guard<std::mutex> lock(worker.Mutex);
+	return worker.Heap.empty() ? INT64_MAX : worker.Heap.front().Deadline;
+}
+
+void DecodeScheduler::RunEntry(int workerIndex, const Entry& entry)
+{
+	ScheduledTask* task = entry.Task;
+	bool run = false;
+	{
+		std::lock_guard<std::mutex> lock(task->Mutex);
+		if (!task->Removed && !task->Running && entry.Generation == task->Generation) {
+			task->Running = true;
+			// 被窃取的任务之后留在窃取者的堆里，保持缓存局部性
+			task->HomeWorker = workerIndex;
+			run = true;
+		}
+	}
+	task->InFlight--;
+	if (!run) return;
+
+	int64_t delay = task->Run ? task->Run() : -1;
+
+	std::lock_guard<std::mutex> lock(task->Mutex);
+	task->Running = false;
+	if (task->Removed) return;
+
+	if (task->WakeRequested) {
+		task->WakeRequested = false;
+		delay = 0;
+	}
+	if (delay >= 0) {
+		Enqueue(task, SchedulerNowUS() + delay);
+	}
+}
+
+void DecodeScheduler::WorkerLoop(int index)
+{
+	Worker& own = *workers[index];
+	int count = (int)workers.size();
+
+	while (!stopping.load())
+	{
+		// 先记下入队序号再检查堆：检查之后到达的任务会改变序号，等待立即返回
+		uint64_t sequence;
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			sequence = enqueueSequence;
+		}
+		int64_t now = SchedulerNowUS();
+		Entry entry;
+
+		if (PopDue(own, now, entry)) {
+			RunEntry(index, entry);
+			continue;
+		}
+
+		bool stolen = false;
+		for (int i = 1; i < count && !stolen; i++) {
+			if (PopDue(*workers[(index + i) % count], now, entry)) {
+				RunEntry(index, entry);
+				stolen = true;
+			}
+		}
+		if (stolen) continue;
+
+		// 睡到任一堆中最早的截止时间（其他线程忙碌时由本线程窃取），所有堆为空时一直睡到有任务入队
+		int64_t wake = INT64_MAX;
+		for (auto& worker : workers) {
+			wake = std::min(wake, NextDeadline(*worker));
+		}
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		auto woken = [&] { return stopping.load() || enqueueSequence != sequence; };
+		sleepingWorkers++;
+		if (wake == INT64_MAX) {
+			sleepCond.wait(lock, woken);
+		}
+		else {
+			sleepCond.wait_for(lock, std::chrono::microseconds(std::max<int64_t>(0, wake - now)), woken);
+		}
+		sleepingWorkers--;
+	}
+}
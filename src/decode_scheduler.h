@@ -0,0 +1,90 @@
+// Copyright (c) 2025 Anders Xiao. All rights reserved.
+// https://github.com/endink
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+  被调度的任务（一个播放器）。Run 执行一个时间片，返回距下一次需要运行的微秒数，
+  0 表示尽快再次运行，负数表示不再调度。
+*/
+struct ScheduledTask {
+	std::function<int64_t()> Run;
+
+	// 以下字段由 DecodeScheduler 维护
+	std::mutex Mutex;
+	bool Running = false;
+	bool Removed = false;
+	bool WakeRequested = false;
+	uint64_t Generation = 0;          // 只有与当前 Generation 相同的队列项有效
+	std::atomic<int> InFlight{ 0 };   // 已从队列取出但尚未处理完的队列项
+	int HomeWorker = 0;
+};
+
+/*
+  进程级共享解码调度器：固定数量的工作线程，每个线程维护一个按截止时间排序的最小堆，
+  自己的堆里没有到期任务时从其他线程的堆中窃取到期任务。
+  播放器按下一帧的呈现时间调度，总线程数随 CPU 核数而不是播放器数量增长。
+*/
+class DecodeScheduler {
+public:
+	static DecodeScheduler& Shared();
+
+	// 在第一次 Add 之前调用有效，0 表示使用 CPU 核数
+	bool Configure(int threadCount);
+
+	void Add(ScheduledTask* task);
+	// 阻塞直到任务不在运行，返回后可以安全销毁 task
+	void Remove(ScheduledTask* task);
+	// 让任务尽快运行（例如有新的控制命令）
+	void Wake(ScheduledTask* task);
+
+	int ThreadCount() const { return (int)workers.size(); }
+
+private:
+	struct Entry {
+		int64_t Deadline;
+		ScheduledTask* Task;
+		uint64_t Generation;
+	};
+
+	struct Worker {
+		std::mutex Mutex;
+		std::vector<Entry> Heap;
+		std::thread Thread;
+	};
+
+	// 最小堆比较：截止时间早的在堆顶
+	static bool Later(const Entry& a, const Entry& b) { return a.Deadline > b.Deadline; }
+
+	DecodeScheduler() = default;
+	~DecodeScheduler();
+
+	void EnsureStarted();
+	void Enqueue(ScheduledTask* task, int64_t deadline);
+	bool PopDue(Worker& worker, int64_t now, Entry& out);
+	int64_t NextDeadline(Worker& worker);
+	void RunEntry(int workerIndex, const Entry& entry);
+	void WorkerLoop(int index);
+
+	std::mutex startMutex;
+	int requestedThreads = 0;
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::atomic<bool> started{ false };
+	std::atomic<bool> stopping{ false };
+	std::atomic<uint32_t> nextWorker{ 0 };
+
+	std::mutex sleepMutex;
+	std::condition_variable sleepCond;
+	// 每次入队递增（sleepMutex 保护），工作线程据此发现检查堆之后、睡眠之前到达的任务
+	uint64_t enqueueSequence = 0;
+	int sleepingWorkers = 0;
+};
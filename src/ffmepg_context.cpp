@@ -8,7 +8,9 @@ extern "C" {
 	#include <libavutil/dict.h>
 	#include <libavutil/imgutils.h>
 	#include <libavutil/display.h>
+	#include <libavutil/cpu.h>
 }
+#include <algorithm>
 
 float GetDecoderFPS(FFmpegContext& context)
 {
@@ -54,6 +56,8 @@ float GetDecoderFPS(FFmpegContext& context)
 
 			ret = avcodec_receive_frame(context.videoCodecContext, frame);
 			if (ret == AVERROR(EAGAIN)) {
+				// 帧级多线程下解码器会先缓存 thread_count - 1 个包
+				av_packet_unref(packet);
 				continue;
 			}
 			if (ret != 0)
@@ -159,7 +163,50 @@ int GetAvStreamRotateAngle(FFmpegContext& context)
 	return 0;
 }
 
-bool FFmpegContext::LoadVideoProperties(bool testDeocderFPS)
+/*
+  自动策略：线程数按分辨率取上限（720p 4、1080p 8、更高 16），且不超过 CPU 核数；
+  解码器支持帧级多线程时优先使用帧级，否则退回片级。
+*/
+void ConfigureDecoderThreads(AVCodecContext* codec_ctx, const AVCodec* codec, int requestedCount, VideoDecoderThreadType requestedType)
+{
+	int cores = av_cpu_count();
+	int count = requestedCount;
+	if (count <= 0) {
+		int64_t pixels = (int64_t)codec_ctx->width * codec_ctx->height;
+		int limit = pixels <= 1280 * 720 ? 4 : (pixels <= 1920 * 1088 ? 8 : 16);
+		count = std::min(cores, limit);
+	}
+	count = std::max(1, count);
+
+	bool canFrame = (codec->capabilities & AV_CODEC_CAP_FRAME_THREADS) != 0;
+	bool canSlice = (codec->capabilities & AV_CODEC_CAP_SLICE_THREADS) != 0;
+
+	int type = 0;
+	switch (requestedType) {
+	case VIDEO_DECODER_THREAD_FRAME:
+		type = FF_THREAD_FRAME;
+		break;
+	case VIDEO_DECODER_THREAD_SLICE:
+		type = FF_THREAD_SLICE;
+		break;
+	case VIDEO_DECODER_THREAD_NONE:
+		count = 1;
+		break;
+	default:
+		type = canFrame ? FF_THREAD_FRAME : (canSlice ? FF_THREAD_SLICE : 0);
+		break;
+	}
+
+	if (type == 0) {
+		count = 1;
+	}
+
+	codec_ctx->thread_count = count;
+	codec_ctx->thread_type = type;
+	LogDebug("Decoder threads requested: %d, type: %d (cores: %d)", count, type, cores);
+}
+
+bool FFmpegContext::LoadVideoProperties(bool testDeocderFPS, bool probeKeyFrames)
 {
 	videoStreamIdx = -1;
 	for (unsigned int i = 0; i < avformatContext->nb_streams; ++i) {
@@ -201,6 +248,9 @@ bool FFmpegContext::LoadVideoProperties(bool testDeocderFPS)
 		return false;
 	}
 
+	ConfigureDecoderThreads(codec_ctx, codec, requestedThreadCount, requestedThreadType);
+	videoBufferPool.Install(codec_ctx);
+
 	if (avcodec_open2(codec_ctx, codec, nullptr) < 0) {
 		LogError("Failed to open codec");
 		avcodec_free_context(&codec_ctx);
@@ -255,15 +305,81 @@ bool FFmpegContext::LoadVideoProperties(bool testDeocderFPS)
 	}
 
 	auto& self = *this;
-	keyFrameGapTime = GetKeyFrameInterval(self);
+	bool readPackets = false;
+	// 探测缓存恢复的完整索引或容器索引可用时不必读包估算
+	if (keyFrames.Complete() || keyFrames.BuildFromContainer(videoStream, frameRate)) {
+		keyFrameGapTime = av_rescale_q(keyFrames.AverageGapUS(), AVRational{ 1, 1000000 }, timebase);
+		LogInfo("Key frame index ready, key frames: %d", (int)keyFrames.Count());
+	}
+	else if (keyFrameGapTime <= 0 && probeKeyFrames) {
+		keyFrameGapTime = GetKeyFrameInterval(self);
+		readPackets = true;
+	}
 	if (testDeocderFPS) {
 		LogDebug("Start test decoder fps.");
 		decoderFPS = GetDecoderFPS(self);
+		readPackets = true;
+	}
+	// 没有读过包时不必 seek（有些容器的 seek 本身就要读包）
+	if (readPackets) {
+		SeekToStart();
 	}
-	SeekToStart();
 	return true;
 }
 
+bool FFmpegContext::OpenAudioStream()
+{
+	audioStreamIdx = -1;
+	audioStream = nullptr;
+
+	const AVCodec* codec = nullptr;
+	int index = av_find_best_stream(avformatContext, AVMEDIA_TYPE_AUDIO, -1, videoStreamIdx, &codec, 0);
+	if (index < 0 || !codec) {
+		LogInfo("No audio stream found");
+		return false;
+	}
+
+	AVCodecContext* codec_ctx = avcodec_alloc_context3(codec);
+	if (!codec_ctx) {
+		LogError("Failed to allocate audio AVCodecContext");
+		return false;
+	}
+
+	AVStream* stream = avformatContext->streams[index];
+	if (avcodec_parameters_to_context(codec_ctx, stream->codecpar) < 0) {
+		LogError("Failed to copy audio codec parameters to context");
+		avcodec_free_context(&codec_ctx);
+		return false;
+	}
+	codec_ctx->pkt_timebase = stream->time_base;
+
+	if (avcodec_open2(codec_ctx, codec, nullptr) < 0) {
+		LogError("Failed to open audio codec");
+		avcodec_free_context(&codec_ctx);
+		return false;
+	}
+
+	audioCodecContext = codec_ctx;
+	audioStream = stream;
+	audioStreamIdx = index;
+	LogInfo("Audio stream index: %d, codec: %s, sample rate: %d, channels: %d", index, codec->name, codec_ctx->sample_rate, codec_ctx->ch_layout.nb_channels);
+	return true;
+}
+
+void FFmpegContext::DiscardUnusedStreams()
+{
+	if (!avformatContext) return;
+
+	int discarded = 0;
+	for (unsigned int i = 0; i < avformatContext->nb_streams; i++) {
+		if ((int)i == videoStreamIdx || (int)i == audioStreamIdx) continue;
+		avformatContext->streams[i]->discard = AVDISCARD_ALL;
+		discarded++;
+	}
+	if (discarded > 0) {
+		LogInfo("Discarded %d unused stream(s) at the demuxer", discarded);
+	}
+}
 
 void FFmpegContext::SeekToStart() const
 {
@@ -291,7 +407,18 @@ void FFmpegContext::FillVideoInfo(VideoInfo& videoInfo) const
 	videoInfo.Rotation = this->videoRotation;
 	videoInfo.DecoderFPS = this->decoderFPS;
 	videoInfo.HasAudio = this->audioStreamIdx >= 0;
+	videoInfo.AudioChannels = audioCodecContext ? audioCodecContext->ch_layout.nb_channels : 0;
+	videoInfo.AudioSampleRate = audioCodecContext ? audioCodecContext->sample_rate : 0;
 	videoInfo.PixelFormat = VideoFrameFormat::VIDEO_FRAME_UNKNWON;
+
+	// active_thread_type 在 avcodec_open2 之后才是实际生效的模式
+	videoInfo.DecoderThreadCount = videoCodecContext ? videoCodecContext->thread_count : 0;
+	if (videoCodecContext && (videoCodecContext->active_thread_type & FF_THREAD_FRAME))
+		videoInfo.DecoderThreadType = VIDEO_DECODER_THREAD_FRAME;
+	else if (videoCodecContext && (videoCodecContext->active_thread_type & FF_THREAD_SLICE))
+		videoInfo.DecoderThreadType = VIDEO_DECODER_THREAD_SLICE;
+	else
+		videoInfo.DecoderThreadType = VIDEO_DECODER_THREAD_NONE;
 	
 
 	// ----------------------------------------
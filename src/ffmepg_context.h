@@ -8,6 +8,8 @@ extern "C" {
 	#include <libavcodec/avcodec.h>
 }
 #include "videoplayer_c_api.h"
+#include "keyframe_index.h"
+#include "frame_buffer_pool.h"
 
 
 struct FFmpegContext {
@@ -17,6 +19,7 @@ struct FFmpegContext {
 	AVCodecContext* videoCodecContext = nullptr;
 	AVCodecContext* audioCodecContext = nullptr;
 	AVStream* videoStream = nullptr;
+	AVStream* audioStream = nullptr;
 	int videoStreamIdx = -1;
 	int audioStreamIdx = -1;
 	int64_t durationInStreamTimebase = 0;
@@ -36,10 +39,29 @@ struct FFmpegContext {
 	  pts unit
 	*/
 	int64_t keyFrameGapTime = 0;
+	// 视频流关键帧索引：LoadVideoProperties 从容器索引构建，没有时由播放器后台扫描
+	KeyFrameIndex keyFrames;
 	double decoderFPS = 0;
 	std::string codecName;
+	// 视频解码器输出帧的缓冲池（get_buffer2），在 codec 关闭之后析构
+	FrameBufferPool videoBufferPool;
 
-	bool LoadVideoProperties(bool testDeocderFPS);
+	// 解码线程配置，LoadVideoProperties 之前设置；0 / AUTO 表示自动
+	int requestedThreadCount = 0;
+	VideoDecoderThreadType requestedThreadType = VIDEO_DECODER_THREAD_AUTO;
+
+	// probeKeyFrames 为 false 时没有可用索引也不读包估算关键帧间隔（快速打开）
+	bool LoadVideoProperties(bool testDeocderFPS, bool probeKeyFrames = true);
+	// 打开最佳音频流的解码器，没有音频或打开失败时返回 false（audioStreamIdx 为 -1）
+	bool OpenAudioStream();
+	// 播放不使用的流（字幕、数据、其他音视频轨道、静音时的音频）设为 AVDISCARD_ALL，demuxer 不再读取和解析它们的包
+	void DiscardUnusedStreams();
+
+	// 视频流起始 pts（微秒），播放时间相对它计算
+	inline int64_t GetStartTimeUS() const {
+		if (!videoStream || videoStream->start_time == AV_NOPTS_VALUE) return 0;
+		return av_rescale_q(videoStream->start_time, videoStream->time_base, AVRational{ 1, 1000000 });
+	}
 
 	inline int64_t getTimeBetweenFrame() const {
 		return one_second_time / (int64_t)(frameRate)+1;
@@ -3,15 +3,23 @@
 extern "C" {
     #include <libavutil/avutil.h>
     #include <libavutil/imgutils.h>
+    #include <libavutil/buffer.h>
     #include <libswscale/swscale.h>
     }
 #include <iostream>
 
+// 转换输出每行按该字节数对齐，满足 sws_scale 的 SIMD 写入要求
+const int kConvertedLineAlign = 64;
+
 struct FormatConverter {
     AVFrame* bufferFrame = nullptr;      // 临时源帧
     AVFrame* convertedFrame = nullptr;   // 转换后的帧
     uint8_t* distBufferData = nullptr;   // 转换帧的数据缓冲
     SwsContext* swsContext = nullptr;
+    // ConvertTo 输出缓冲池：槽位帧仍被邮箱 / 回调引用时从池中取新缓冲，引用释放后回池复用
+    AVBufferPool* outputPool = nullptr;
+    int outputLinesize[4] = {};
+    size_t outputPlaneSize[4] = {};
 
     int srcWidth = 0;
     int srcHeight = 0;
@@ -58,6 +66,9 @@ struct FormatConverter {
             swsContext = nullptr;
         }
 
+        // 仍被帧引用的缓冲在归还后释放
+        av_buffer_pool_uninit(&outputPool);
+
         if (bufferFrame) {
             av_frame_unref(bufferFrame);
             av_frame_free(&bufferFrame);
@@ -83,7 +94,79 @@ struct FormatConverter {
         convertedFrame->pts = frame->pts;
     }
 
+    // 转换到外部帧（例如帧队列槽位），目标缓冲可写且尺寸一致时复用，否则从输出缓冲池取
+    bool ConvertTo(AVFrame* sourceFrame, AVFrame* distFrame) {
+        if (!sourceFrame || !distFrame) return false;
+
+        if (!distFrame->buf[0] ||
+            distFrame->width != distWidth ||
+            distFrame->height != distHeight ||
+            distFrame->format != distPixelFormat ||
+            !av_frame_is_writable(distFrame)) {
+            av_frame_unref(distFrame);
+            distFrame->width = distWidth;
+            distFrame->height = distHeight;
+            distFrame->format = distPixelFormat;
+            if (!GetOutputBuffer(distFrame)) {
+                return false;
+            }
+        }
+
+        LoadContext(static_cast<AVPixelFormat>(sourceFrame->format));
+
+        sws_scale(
+            swsContext,
+            sourceFrame->data,
+            sourceFrame->linesize,
+            0,
+            sourceFrame->height,
+            distFrame->data,
+            distFrame->linesize
+        );
+
+        distFrame->pts = sourceFrame->pts;
+        return true;
+    }
+
 private:
+    // 所有平面放在一块池缓冲中，每个平面起点和行宽都按 kConvertedLineAlign 对齐
+    bool GetOutputBuffer(AVFrame* frame) {
+        if (!outputPool) {
+            if (av_image_fill_linesizes(outputLinesize, distPixelFormat, distWidth) < 0) {
+                return false;
+            }
+            ptrdiff_t strides[4];
+            for (int i = 0; i < 4; i++) {
+                outputLinesize[i] = FFALIGN(outputLinesize[i], kConvertedLineAlign);
+                strides[i] = outputLinesize[i];
+            }
+            if (av_image_fill_plane_sizes(outputPlaneSize, distPixelFormat, distHeight, strides) < 0) {
+                return false;
+            }
+            size_t total = 0;
+            for (size_t size : outputPlaneSize) {
+                total += size;
+            }
+            outputPool = av_buffer_pool_init(total + kConvertedLineAlign, nullptr);
+            if (!outputPool) {
+                return false;
+            }
+        }
+
+        frame->buf[0] = av_buffer_pool_get(outputPool);
+        if (!frame->buf[0]) {
+            return false;
+        }
+        uint8_t* data = frame->buf[0]->data;
+        for (int i = 0; i < 4; i++) {
+            frame->data[i] = outputPlaneSize[i] > 0 ? data : nullptr;
+            frame->linesize[i] = outputPlaneSize[i] > 0 ? outputLinesize[i] : 0;
+            data += outputPlaneSize[i];
+        }
+        frame->extended_data = frame->data;
+        return true;
+    }
+
     AVFrame* InitAVFrame(int width, int height, AVPixelFormat format, uint8_t** buffer) {
         AVFrame* frame = av_frame_alloc();
         if (!frame) return nullptr;
@@ -0,0 +1,127 @@
+// Copyright (c) 2025 Anders Xiao. All rights reserved.
+// https://github.com/endink
+
+#include "frame_buffer_pool.h"
+
+extern "C" {
+	#include <libavutil/imgutils.h>
+	#include <libavutil/pixdesc.h>
+}
+
+// 与 libavcodec 默认分配一致：平面尾部留出 SIMD 越界读写的余量
+const int kFramePlanePadding = 16 + 64 - 1;
+
+void FrameBufferPool::Install(AVCodecContext* codecCtx)
+{
+	if (!codecCtx || !codecCtx->codec || !(codecCtx->codec->capabilities & AV_CODEC_CAP_DR1)) {
+		return;
+	}
+	codecCtx->opaque = this;
+	codecCtx->get_buffer2 = &FrameBufferPool::GetBuffer2;
+}
+
+int FrameBufferPool::GetBuffer2(AVCodecContext* codecCtx, AVFrame* frame, int flags)
+{
+	auto* pool = static_cast<FrameBufferPool*>(codecCtx->opaque);
+	if (codecCtx->codec_type != AVMEDIA_TYPE_VIDEO || !pool || !pool->Allocate(codecCtx, frame)) {
+		return avcodec_default_get_buffer2(codecCtx, frame, flags);
+	}
+	return 0;
+}
+
+bool FrameBufferPool::Allocate(AVCodecContext* codecCtx, AVFrame* frame)
+{
+	const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+	if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL))) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!UpdateLocked(codecCtx, frame->width, frame->height, static_cast<AVPixelFormat>(frame->format))) {
+		return false;
+	}
+
+	for (int i = 0; i < planes; i++) {
+		frame->buf[i] = av_buffer_pool_get(pools[i]);
+		if (!frame->buf[i]) {
+			for (int j = 0; j < i; j++) {
+				av_buffer_unref(&frame->buf[j]);
+			}
+			return false;
+		}
+		frame->data[i] = frame->buf[i]->data;
+		frame->linesize[i] = linesize[i];
+	}
+	for (int i = planes; i < AV_NUM_DATA_POINTERS; i++) {
+		frame->data[i] = nullptr;
+		frame->linesize[i] = 0;
+	}
+	frame->extended_data = frame->data;
+	return true;
+}
+
+// 按 libavcodec 的规则计算对齐后的行宽和平面大小，参数不变时直接复用现有的池
+bool FrameBufferPool::UpdateLocked(AVCodecContext* codecCtx, int frameWidth, int frameHeight, AVPixelFormat frameFormat)
+{
+	if (planes > 0 && width == frameWidth && height == frameHeight && format == frameFormat) {
+		return true;
+	}
+	ReleasePools();
+
+	int w = frameWidth;
+	int h = frameHeight;
+	int align[AV_NUM_DATA_POINTERS] = {};
+	avcodec_align_dimensions2(codecCtx, &w, &h, align);
+
+	int lines[4] = {};
+	int unaligned = 0;
+	do {
+		// 行宽不满足对齐要求时加宽，直到每个平面的 linesize 都对齐
+		if (av_image_fill_linesizes(lines, frameFormat, w) < 0) {
+			return false;
+		}
+		w += w & ~(w - 1);
+		unaligned = 0;
+		for (int i = 0; i < 4; i++) {
+			unaligned |= align[i] ? lines[i] % align[i] : 0;
+		}
+	} while (unaligned);
+
+	ptrdiff_t strides[4] = { lines[0], lines[1], lines[2], lines[3] };
+	size_t sizes[4] = {};
+	if (av_image_fill_plane_sizes(sizes, frameFormat, h, strides) < 0) {
+		return false;
+	}
+
+	int count = 0;
+	for (int i = 0; i < 4 && sizes[i] > 0; i++) {
+		pools[i] = av_buffer_pool_init(sizes[i] + kFramePlanePadding, nullptr);
+		if (!pools[i]) {
+			ReleasePools();
+			return false;
+		}
+		linesize[i] = lines[i];
+		count++;
+	}
+
+	planes = count;
+	width = frameWidth;
+	height = frameHeight;
+	format = frameFormat;
+	return planes > 0;
+}
+
+// 已借出的缓冲仍然有效，池在它们全部归还后释放
+void FrameBufferPool::ReleasePools()
+{
+	for (auto& pool : pools) {
+		av_buffer_pool_uninit(&pool);
+	}
+	for (auto& line : linesize) {
+		line = 0;
+	}
+	planes = 0;
+	width = 0;
+	height = 0;
+	format = AV_PIX_FMT_NONE;
+}
@@ -0,0 +1,45 @@
+// Copyright (c) 2025 Anders Xiao. All rights reserved.
+// https://github.com/endink
+
+#pragma once
+
+#include <mutex>
+extern "C" {
+	#include <libavcodec/avcodec.h>
+	#include <libavutil/buffer.h>
+}
+
+/*
+  视频解码器的输出缓冲池：作为 get_buffer2 安装到 AVCodecContext，按平面从 AVBufferPool 取对齐的缓冲，
+  帧释放后缓冲回到池中，稳定播放时解码不再为每帧分配像素内存。
+  分辨率 / 像素格式变化时重建；不支持 DR1 的解码器、硬件格式和调色板格式仍走 avcodec_default_get_buffer2。
+  frame 线程会并发调用 get_buffer2，必须比 AVCodecContext 活得久（池本身在最后一个缓冲归还后才真正释放）。
+*/
+class FrameBufferPool {
+public:
+	FrameBufferPool() = default;
+	FrameBufferPool(const FrameBufferPool&) = delete;
+	FrameBufferPool& operator=(const FrameBufferPool&) = delete;
+
+	~FrameBufferPool() {
+		ReleasePools();
+	}
+
+	// avcodec_open2 之前调用
+	void Install(AVCodecContext* codecCtx);
+
+private:
+	static int GetBuffer2(AVCodecContext* codecCtx, AVFrame* frame, int flags);
+
+	bool Allocate(AVCodecContext* codecCtx, AVFrame* frame);
+	bool UpdateLocked(AVCodecContext* codecCtx, int frameWidth, int frameHeight, AVPixelFormat frameFormat);
+	void ReleasePools();
+
+	std::mutex mutex;
+	AVBufferPool* pools[4] = {};
+	int linesize[4] = {};
+	int planes = 0;
+	int width = 0;
+	int height = 0;
+	AVPixelFormat format = AV_PIX_FMT_NONE;
+};
@@ -0,0 +1,90 @@
+// Copyright (c) 2025 Anders Xiao. All rights reserved.
+// https://github.com/endink
+
+#pragma once
+
+#include "video_frame.h"
+#include <atomic>
+#include <cstdint>
+
+/*
+  单生产者 / 单消费者的无锁三缓冲邮箱。
+  呈现线程 Publish 最新帧（只增加 AVFrame 引用，不拷贝像素），引擎 tick 线程 Acquire 拿到最新完成的帧，
+  消费者来不及取的旧帧直接被覆盖而不是排队。
+*/
+struct FrameMailbox {
+	static const uint8_t kIndexMask = 0x3;
+	static const uint8_t kDirtyBit = 0x4;
+
+	VideoFrame slots[3];
+	// 生产者独占 back，消费者独占 front，middle 在两者之间原子交换
+	int back = 0;
+	int front = 1;
+	std::atomic<uint8_t> middle{ 2 };
+
+	FrameMailbox() {
+		for (auto& slot : slots) {
+			slot.AvFrame = av_frame_alloc();
+		}
+	}
+
+	FrameMailbox(const FrameMailbox&) = delete;
+	FrameMailbox& operator=(const FrameMailbox&) = delete;
+
+	~FrameMailbox() {
+		for (auto& slot : slots) {
+			av_frame_free(&slot.AvFrame);
+		}
+	}
+
+	// producer
+	bool Publish(const VideoFrame& frame) {
+		VideoFrame& slot = slots[back];
+		av_frame_unref(slot.AvFrame);
+		if (av_frame_ref(slot.AvFrame, frame.AvFrame) < 0) {
+			return false;
+		}
+		slot.Width = frame.Width;
+		slot.Height = frame.Height;
+		slot.Rotation = frame.Rotation;
+		slot.TimeMills = frame.TimeMills;
+		slot.OutputBuffer = frame.OutputBuffer;
+		slot.Context = frame.Context;
+
+		uint8_t previous = middle.exchange(static_cast<uint8_t>(back | kDirtyBit), std::memory_order_acq_rel);
+		back = previous & kIndexMask;
+		return true;
+	}
+
+	// producer: 最近发布的帧还没有被消费者取走
+	bool HasUnread() const {
+		return (middle.load(std::memory_order_acquire) & kDirtyBit) != 0;
+	}
+
+	// consumer: 返回自上次 Acquire 之后发布的最新帧，没有新帧时返回 nullptr
+	VideoFrame* Acquire() {
+		if ((middle.load(std::memory_order_relaxed) & kDirtyBit) == 0) {
+			return nullptr;
+		}
+		uint8_t previous = middle.exchange(static_cast<uint8_t>(front), std::memory_order_acq_rel);
+		front = previous & kIndexMask;
+		return &slots[front];
+	}
+
+	// consumer: 提前释放 front 帧的引用，让解码 / 转换缓冲可以被复用
+	void Release(const VideoFrame* frame) {
+		if (frame == &slots[front]) {
+			av_frame_unref(slots[front].AvFrame);
+		}
+	}
+
+	// 仅在生产者和消费者都不活动时调用
+	void Reset() {
+		for (auto& slot : slots) {
+			av_frame_unref(slot.AvFrame);
+		}
+		back = 0;
+		front = 1;
+		middle.store(2);
+	}
+};
@@ -0,0 +1,101 @@
+// Copyright (c) 2025 Anders Xiao. All rights reserved.
+// https://github.com/endink
+
+#include "frame_pacer.h"
+#include "commons.h"
+
+#include <thread>
+
+#if defined(PLATFORM_WINDOWS)
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+int64_t MonotonicNowUS()
+{
+	static const int64_t frequency = [] {
+		LARGE_INTEGER f;
+		QueryPerformanceFrequency(&f);
+		return (int64_t)f.QuadPart;
+	}();
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	int64_t ticks = counter.QuadPart;
+	return ticks / frequency * 1000000 + ticks % frequency * 1000000 / frequency;
+}
+
+// 每个线程一个高精度 waitable timer（Windows 10 1803+），不支持时退回普通 timer
+struct ThreadTimer {
+	HANDLE Handle = nullptr;
+
+	ThreadTimer() {
+		Handle = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+		if (!Handle) {
+			Handle = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+		}
+	}
+
+	~ThreadTimer() {
+		if (Handle) CloseHandle(Handle);
+	}
+};
+
+static void SleepForUS(int64_t us)
+{
+	thread_local ThreadTimer timer;
+	if (timer.Handle) {
+		LARGE_INTEGER due;
+		due.QuadPart = -us * 10; // 相对时间，100ns 单位
+		if (SetWaitableTimer(timer.Handle, &due, 0, nullptr, nullptr, FALSE)) {
+			WaitForSingleObject(timer.Handle, INFINITE);
+			return;
+		}
+	}
+	Sleep((DWORD)(us / 1000));
+}
+
+#else
+
+#include <time.h>
+#include <errno.h>
+
+int64_t MonotonicNowUS()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#endif
+
+int64_t SleepUntilUS(int64_t deadlineUS, int64_t spinUS)
+{
+	int64_t wakeUS = deadlineUS - std::max<int64_t>(0, spinUS);
+	int64_t now = MonotonicNowUS();
+
+	if (wakeUS > now) {
+#if defined(PLATFORM_WINDOWS)
+		SleepForUS(wakeUS - now);
+#elif defined(__APPLE__)
+		struct timespec ts;
+		int64_t us = wakeUS - now;
+		ts.tv_sec = us / 1000000;
+		ts.tv_nsec = (us % 1000000) * 1000;
+		while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {}
+#else
+		// 绝对 deadline：被信号打断后重试不会累积误差
+		struct timespec ts;
+		ts.tv_sec = wakeUS / 1000000;
+		ts.tv_nsec = (wakeUS % 1000000) * 1000;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+#endif
+		now = MonotonicNowUS();
+	}
+
+	while (now < deadlineUS) {
+		std::this_thread::yield();
+		now = MonotonicNowUS();
+	}
+	return now;
+}
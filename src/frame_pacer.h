@@ -0,0 +1,51 @@
+// Copyright (c) 2025 Anders Xiao. All rights reserved.
+// https://github.com/endink
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+
+// 呈现误差在该范围内视为准时
+const int64_t kPacingToleranceUS = 500;
+
+// 单调时钟（微秒），不受系统时间调整影响，所有呈现 deadline 都基于它
+int64_t MonotonicNowUS();
+
+/*
+  睡眠到绝对 deadline（MonotonicNowUS 时基）：先用系统高精度定时器睡到 deadline - spinUS，
+  再自旋到 deadline，吸收定时器的唤醒延迟。返回醒来时的 MonotonicNowUS。
+*/
+int64_t SleepUntilUS(int64_t deadlineUS, int64_t spinUS);
+
+// 呈现抖动统计（实际呈现时间 - 目标时间），呈现线程写，任意线程读
+struct PacingStats {
+    std::atomic<int64_t> Samples{ 0 };
+    std::atomic<int64_t> OnTime{ 0 };
+    std::atomic<int64_t> TotalAbsErrorUS{ 0 };
+    std::atomic<int64_t> MaxAbsErrorUS{ 0 };
+
+    void Add(int64_t errorUS) {
+        int64_t absError = std::abs(errorUS);
+        Samples++;
+        if (absError <= kPacingToleranceUS) OnTime++;
+        TotalAbsErrorUS += absError;
+        if (absError > MaxAbsErrorUS.load(std::memory_order_relaxed)) {
+            MaxAbsErrorUS.store(absError, std::memory_order_relaxed);
+        }
+    }
+
+    int64_t AverageAbsErrorUS() const {
+        int64_t samples = Samples.load();
+        return samples > 0 ? TotalAbsErrorUS.load() / samples : 0;
+    }
+
+    void Reset() {
+        Samples = 0;
+        OnTime = 0;
+        TotalAbsErrorUS = 0;
+        MaxAbsErrorUS = 0;
+    }
+};
@@ -0,0 +1,152 @@
+// Copyright (c) 2025 Anders Xiao. All rights reserved.
+// https://github.com/endink
+
+#pragma once
+
+extern "C" {
+    #include <libavutil/frame.h>
+    }
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <chrono>
+
+struct FFmpegContext;
+
+const int kDefaultFrameQueueSize = 3;
+const int kMaxFrameQueueSize = 16;
+
+struct QueuedFrame {
+    AVFrame* Frame = nullptr;
+    int64_t PtsUS = 0;
+    int64_t DurationUS = 0;
+    int Serial = 0;          // 解码序列号，seek / 循环时递增，呈现线程据此重新对齐时钟
+    int PacketSerial = 0;    // 来源包的 PacketQueue 序列号，与队列当前序列号不同表示 seek 前的旧帧
+    bool Converted = false;  // Frame 持有转换后的缓冲（可复用），否则为解码器帧的引用
+    bool EndOfStream = false; // 离线模式的流结束标记，不携带画面
+    int OutputBuffer = -1;   // Frame 写在调用者注册的第几个输出缓冲中，-1 表示内部缓冲
+    FFmpegContext* Context = nullptr; // 帧所属的媒体，playlist 切换后队列中仍可能有上一项的帧
+};
+
+/*
+  解码线程与呈现线程之间的定长环形帧队列。
+  解码线程 PeekWritable -> 填充 -> Push，呈现线程 PeekReadable -> 呈现 -> Next。
+*/
+struct FrameQueue {
+    std::vector<QueuedFrame> slots;
+    int readIndex = 0;
+    int writeIndex = 0;
+    int count = 0;
+    bool aborted = false;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+
+    FrameQueue() = default;
+    FrameQueue(const FrameQueue&) = delete;
+    FrameQueue& operator=(const FrameQueue&) = delete;
+
+    ~FrameQueue() {
+        for (auto& slot : slots) {
+            av_frame_free(&slot.Frame);
+        }
+    }
+
+    bool Init(int capacity) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (capacity <= 0) capacity = kDefaultFrameQueueSize;
+        capacity = std::min(capacity, kMaxFrameQueueSize);
+
+        for (auto& slot : slots) {
+            av_frame_free(&slot.Frame);
+        }
+        slots.assign(capacity, QueuedFrame());
+        for (auto& slot : slots) {
+            slot.Frame = av_frame_alloc();
+            if (!slot.Frame) return false;
+        }
+        readIndex = writeIndex = count = 0;
+        return true;
+    }
+
+    int Capacity() const {
+        return (int)slots.size();
+    }
+
+    int Size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return count;
+    }
+
+    // 返回可写槽位；block 为 true 时等待空槽位，返回 nullptr 表示已中止或（非阻塞时）队列已满
+    QueuedFrame* PeekWritable(bool block = true) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (block) {
+            cond.wait(lock, [this] { return aborted || count < Capacity(); });
+        }
+        return (aborted || count >= Capacity()) ? nullptr : &slots[writeIndex];
+    }
+
+    void Push() {
+        std::lock_guard<std::mutex> lock(mutex);
+        writeIndex = (writeIndex + 1) % Capacity();
+        count++;
+        cond.notify_all();
+    }
+
+    // 返回队首帧；block 为 true 时等待，返回 nullptr 表示已中止或（非阻塞时）队列为空
+    QueuedFrame* PeekReadable(bool block = true) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (block) {
+            cond.wait(lock, [this] { return aborted || count > 0; });
+        }
+        return (aborted || count == 0) ? nullptr : &slots[readIndex];
+    }
+
+    // 最多等待 timeoutMills 直到有可呈现的帧，返回 nullptr 表示超时或已中止
+    QueuedFrame* PeekReadableFor(int timeoutMills) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait_for(lock, std::chrono::milliseconds(std::max(0, timeoutMills)), [this] { return aborted || count > 0; });
+        return (aborted || count == 0) ? nullptr : &slots[readIndex];
+    }
+
+    // 释放当前读槽位；转换缓冲保留给下一次写入复用，注册的输出缓冲交还给调用者的轮转
+    void Next() {
+        std::lock_guard<std::mutex> lock(mutex);
+        ReleaseSlot(slots[readIndex]);
+        readIndex = (readIndex + 1) % Capacity();
+        count--;
+        cond.notify_all();
+    }
+
+    void Flush() {
+        std::lock_guard<std::mutex> lock(mutex);
+        while (count > 0) {
+            ReleaseSlot(slots[readIndex]);
+            readIndex = (readIndex + 1) % Capacity();
+            count--;
+        }
+        readIndex = writeIndex = 0;
+        cond.notify_all();
+    }
+
+    void Abort() {
+        std::lock_guard<std::mutex> lock(mutex);
+        aborted = true;
+        cond.notify_all();
+    }
+
+    void Start() {
+        std::lock_guard<std::mutex> lock(mutex);
+        aborted = false;
+    }
+
+private:
+    static void ReleaseSlot(QueuedFrame& slot) {
+        if (!slot.Converted || slot.OutputBuffer >= 0) {
+            av_frame_unref(slot.Frame);
+            slot.OutputBuffer = -1;
+        }
+    }
+};
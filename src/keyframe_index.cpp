@@ -0,0 +1,186 @@
+// Copyright (c) 2025 Anders Xiao. All rights reserved.
+// https://github.com/endink
+
+#include "keyframe_index.h"
+#include "commons.h"
+#include "video_stream.h"
+
+#include <cmath>
+#include <memory>
+extern "C" {
+	#include <libavutil/time.h>
+}
+
+const size_t kScanIoBufferSize = 64 * 1024;
+
+/*
+  mov/mp4 的索引时间戳是 DTS，有 B 帧时比关键帧的 PTS 早一个重排延迟；mkv cues 等本身就是 PTS。
+  用流的 start_time（第一帧 PTS）减去第一条索引的时间戳得到 pts - dts，PTS 索引上为 0。
+  start_time 未知时，只有 DTS 被平移到负数的索引（mov 编辑列表）才按 video_delay 帧估算。
+*/
+static int64_t ContainerIndexPtsOffset(AVStream* stream, double frameRate)
+{
+	const AVIndexEntry* first = avformat_index_get_entry(stream, 0);
+	if (!first || first->timestamp == AV_NOPTS_VALUE) {
+		return 0;
+	}
+	if (stream->start_time != AV_NOPTS_VALUE) {
+		return std::max<int64_t>(stream->start_time - first->timestamp, 0);
+	}
+	if (first->timestamp < 0 && stream->codecpar->video_delay > 0 && frameRate > 0) {
+		return av_rescale_q((int64_t)std::llround(stream->codecpar->video_delay * 1000000.0 / frameRate), AVRational{ 1, 1000000 }, stream->time_base);
+	}
+	return 0;
+}
+
+bool KeyFrameIndex::BuildFromContainer(AVStream* stream, double frameRate)
+{
+	if (!stream) return false;
+
+	int count = avformat_index_get_entries_count(stream);
+	int64_t pts_offset = ContainerIndexPtsOffset(stream, frameRate);
+	std::vector<KeyFrameEntry> keys;
+	int last_key = -1;
+	bool has_non_key = false;
+	for (int i = 0; i < count; i++) {
+		const AVIndexEntry* entry = avformat_index_get_entry(stream, i);
+		if (!entry) break;
+		if (!(entry->flags & AVINDEX_KEYFRAME)) {
+			has_non_key = true;
+			continue;
+		}
+		int64_t pts_us = av_rescale_q(entry->timestamp + pts_offset, stream->time_base, AVRational{ 1, 1000000 });
+		if (!keys.empty() && pts_us <= keys.back().PtsUS) continue;
+		if (!keys.empty()) {
+			// mp4 等容器索引包含每一帧，直接计数（解码顺序，两个关键帧之间的帧数与显示顺序相同）；只有关键帧的索引（mkv cues）按帧率估算
+			keys.back().GopSize = i - last_key;
+		}
+		KeyFrameEntry key;
+		key.PtsUS = pts_us;
+		key.Pos = entry->pos;
+		keys.push_back(key);
+		last_key = i;
+	}
+
+	if (keys.size() < 2) {
+		return false;
+	}
+
+	if (has_non_key) {
+		keys.back().GopSize = count - last_key;
+	}
+	else {
+		for (size_t i = 0; i < keys.size(); i++) {
+			keys[i].GopSize = (i + 1 < keys.size() && frameRate > 0)
+				? (int32_t)std::lround((keys[i + 1].PtsUS - keys[i].PtsUS) * frameRate / 1000000.0)
+				: 0;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	entries = std::move(keys);
+	source = KeyFrameIndexSource::Container;
+	complete = true;
+	return true;
+}
+
+bool KeyFrameIndex::BuildFromScan(AVFormatContext* fmt, int streamIndex, const std::atomic<bool>& cancel)
+{
+	if (!fmt || streamIndex < 0 || streamIndex >= (int)fmt->nb_streams) return false;
+
+	AVStream* stream = fmt->streams[streamIndex];
+	AVPacket* packet = av_packet_alloc();
+	if (!packet) return false;
+
+	source = KeyFrameIndexSource::Scan;
+	int32_t gop_size = 0;
+	bool has_key = false;
+	int ret = 0;
+	while (!cancel.load())
+	{
+		ret = av_read_frame(fmt, packet);
+		if (ret < 0) break;
+
+		if (packet->stream_index == streamIndex) {
+			int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+			if ((packet->flags & AV_PKT_FLAG_KEY) && pts != AV_NOPTS_VALUE) {
+				if (has_key) SetLastGopSize(gop_size);
+				KeyFrameEntry key;
+				key.PtsUS = av_rescale_q(pts, stream->time_base, AVRational{ 1, 1000000 });
+				key.Pos = packet->pos;
+				Append(key);
+				has_key = true;
+				gop_size = 0;
+			}
+			gop_size++;
+		}
+		av_packet_unref(packet);
+	}
+	av_packet_free(&packet);
+
+	if (cancel.load()) {
+		return false;
+	}
+	if (has_key) SetLastGopSize(gop_size);
+	if (ret != AVERROR_EOF) {
+		LogWarning("Key frame scan stopped: %s", getAvError(ret));
+		return false;
+	}
+	complete = true;
+	return true;
+}
+
+static int ScanReadCallback(void* opaque, uint8_t* data, int len)
+{
+	int n = static_cast<IVideoStream*>(opaque)->Read(data, len);
+	return n == 0 ? AVERROR_EOF : n;
+}
+
+static int64_t ScanSeekCallback(void* opaque, int64_t offset, int whence)
+{
+	return static_cast<IVideoStream*>(opaque)->Seek(offset, whence);
+}
+
+bool ScanKeyFramesFromFile(const std::string& file, int streamIndex, KeyFrameIndex& index, const std::atomic<bool>& cancel)
+{
+	auto io = std::make_unique<VideoFileStream>(file);
+	uint8_t* buffer = reinterpret_cast<uint8_t*>(av_malloc(kScanIoBufferSize));
+	AVIOContext* avio = buffer ? avio_alloc_context(buffer, (int)kScanIoBufferSize, 0, io.get(), ScanReadCallback, nullptr, ScanSeekCallback) : nullptr;
+	AVFormatContext* fmt = avio ? avformat_alloc_context() : nullptr;
+	if (!fmt) {
+		LogError("Key frame scan: allocation failed.");
+		if (avio) {
+			av_freep(&avio->buffer);
+			avio_context_free(&avio);
+		}
+		else {
+			av_free(buffer);
+		}
+		return false;
+	}
+	fmt->pb = avio;
+	fmt->flags = AVFMT_FLAG_CUSTOM_IO;
+
+	bool ok = false;
+	int ret = avformat_open_input(&fmt, NULL, NULL, NULL);
+	if (ret < 0) {
+		// avformat_open_input 失败时已释放 fmt
+		LogError("Key frame scan: avformat_open_input failed: %s", getAvError(ret));
+	}
+	else {
+		// 不调用 avformat_find_stream_info（会解码），同一 demuxer 对同一文件的流序号一致
+		for (unsigned int i = 0; i < fmt->nb_streams; i++) {
+			fmt->streams[i]->discard = (int)i == streamIndex ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+		}
+		int64_t start = av_gettime_relative();
+		ok = index.BuildFromScan(fmt, streamIndex, cancel);
+		if (ok) {
+			LogInfo("Key frame scan finished, key frames: %d, cost: %lld ms", (int)index.Count(), (long long)((av_gettime_relative() - start) / 1000));
+		}
+		avformat_close_input(&fmt);
+	}
+
+	av_freep(&avio->buffer);
+	avio_context_free(&avio);
+	return ok;
+}
@@ -0,0 +1,130 @@
+// Copyright (c) 2025 Anders Xiao. All rights reserved.
+// https://github.com/endink
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+extern "C" {
+	#include <libavformat/avformat.h>
+}
+
+struct KeyFrameEntry {
+	int64_t PtsUS = 0;    // 流时间戳（微秒，含 start_time）
+	int64_t Pos = -1;     // 包在文件中的字节位置，未知为 -1
+	int32_t GopSize = 0;  // 从该关键帧到下一个关键帧之前的帧数，未知为 0
+};
+
+enum class KeyFrameIndexSource {
+	None = 0,
+	Container,  // 容器自带的索引（mp4 stss / mkv cues / avi idx1 ...）
+	Scan,       // 后台只读包、不解码扫描得到
+};
+
+/*
+  视频流的关键帧索引，按 PtsUS 升序。
+  Open 时从容器索引构建；容器没有索引时由后台线程扫描逐步追加，查询线程安全。
+*/
+class KeyFrameIndex {
+public:
+	void Reset() {
+		std::lock_guard<std::mutex> lock(mutex);
+		entries.clear();
+		source = KeyFrameIndexSource::None;
+		complete = false;
+	}
+
+	// 从探测缓存恢复
+	void Load(std::vector<KeyFrameEntry> cached, KeyFrameIndexSource cachedSource, bool cachedComplete) {
+		std::lock_guard<std::mutex> lock(mutex);
+		entries = std::move(cached);
+		source = cachedSource;
+		complete = cachedComplete;
+	}
+
+	std::vector<KeyFrameEntry> Snapshot() const {
+		std::lock_guard<std::mutex> lock(mutex);
+		return entries;
+	}
+
+	// 从 demuxer 已加载的索引构建，DTS 索引换算为 PTS，关键帧少于 2 个时视为没有索引
+	bool BuildFromContainer(AVStream* stream, double frameRate);
+
+	// 顺序读取所有包（不解码）构建，cancel 置位时提前返回 false
+	bool BuildFromScan(AVFormatContext* fmt, int streamIndex, const std::atomic<bool>& cancel);
+
+	// 不超过 pts_us 的最后一个关键帧，O(log n)
+	bool Find(int64_t pts_us, KeyFrameEntry& out) const {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = std::upper_bound(entries.begin(), entries.end(), pts_us,
+			[](int64_t value, const KeyFrameEntry& e) { return value < e.PtsUS; });
+		if (it == entries.begin()) {
+			return false;
+		}
+		out = *(it - 1);
+		return true;
+	}
+
+	size_t Copy(KeyFrameEntry* out, size_t capacity) const {
+		std::lock_guard<std::mutex> lock(mutex);
+		size_t count = std::min(capacity, entries.size());
+		if (out) {
+			std::copy(entries.begin(), entries.begin() + count, out);
+		}
+		return entries.size();
+	}
+
+	// 索引已覆盖 pts_us：扫描完成，或 pts_us 不超过已扫描到的最后一个关键帧
+	bool Covers(int64_t pts_us) const {
+		std::lock_guard<std::mutex> lock(mutex);
+		return complete.load() || (!entries.empty() && pts_us <= entries.back().PtsUS);
+	}
+
+	size_t Count() const {
+		std::lock_guard<std::mutex> lock(mutex);
+		return entries.size();
+	}
+
+	// 已知的最长 GOP 帧数，未知为 0
+	int32_t MaxGopSize() const {
+		std::lock_guard<std::mutex> lock(mutex);
+		int32_t size = 0;
+		for (const auto& e : entries) size = std::max(size, e.GopSize);
+		return size;
+	}
+
+	// 相邻关键帧的平均间隔（微秒），不足 2 个关键帧时返回 -1
+	int64_t AverageGapUS() const {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (entries.size() < 2) return -1;
+		return (entries.back().PtsUS - entries.front().PtsUS) / (int64_t)(entries.size() - 1);
+	}
+
+	KeyFrameIndexSource Source() const { return source.load(); }
+	bool Complete() const { return complete.load(); }
+
+private:
+	// 扫描线程追加，调用者保证 pts 递增
+	void Append(const KeyFrameEntry& entry) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!entries.empty() && entry.PtsUS <= entries.back().PtsUS) return;
+		entries.push_back(entry);
+	}
+
+	void SetLastGopSize(int32_t gopSize) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!entries.empty()) entries.back().GopSize = gopSize;
+	}
+
+	mutable std::mutex mutex;
+	std::vector<KeyFrameEntry> entries;
+	std::atomic<KeyFrameIndexSource> source{ KeyFrameIndexSource::None };
+	std::atomic<bool> complete{ false };
+};
+
+// 为文件路径单独打开一个 demuxer 扫描关键帧（不与播放共享 IO），fd 输入无法并发读取，不支持
+bool ScanKeyFramesFromFile(const std::string& file, int streamIndex, KeyFrameIndex& index, const std::atomic<bool>& cancel);
@@ -0,0 +1,55 @@
+// Copyright (c) 2025 Anders Xiao. All rights reserved.
+// https://github.com/endink
+
+#pragma once
+
+extern "C" {
+	#include <libavutil/avutil.h>
+}
+#include <atomic>
+#include <cstdint>
+
+/*
+  可被任意线程读取的媒体时钟：记录某一 MonotonicNowUS 时刻对应的媒体时间（微秒）和速率，
+  读取时外推到当前时刻。写入方唯一，读取用序列锁避免读到不一致的三元组。
+*/
+struct MediaClock {
+	std::atomic<uint32_t> sequence{ 0 };
+	std::atomic<int64_t> ptsUS{ AV_NOPTS_VALUE };
+	std::atomic<int64_t> updatedUS{ 0 };
+	std::atomic<double> rate{ 1.0 };
+
+	void Set(int64_t pts_us, int64_t now_us, double clock_rate) {
+		sequence.fetch_add(1, std::memory_order_relaxed);
+		// 奇数序号先于数据可见
+		std::atomic_thread_fence(std::memory_order_release);
+		ptsUS.store(pts_us, std::memory_order_relaxed);
+		updatedUS.store(now_us, std::memory_order_relaxed);
+		rate.store(clock_rate, std::memory_order_relaxed);
+		sequence.fetch_add(1, std::memory_order_release);
+	}
+
+	void Invalidate() {
+		Set(AV_NOPTS_VALUE, 0, 1.0);
+	}
+
+	// 返回 now_us 时刻的媒体时间，未设置或超过 max_age_us 未更新时返回 AV_NOPTS_VALUE
+	int64_t Get(int64_t now_us, int64_t max_age_us) const {
+		int64_t pts_us, updated_us;
+		double clock_rate;
+		uint32_t begin;
+		do {
+			begin = sequence.load(std::memory_order_acquire);
+			pts_us = ptsUS.load(std::memory_order_relaxed);
+			updated_us = updatedUS.load(std::memory_order_relaxed);
+			clock_rate = rate.load(std::memory_order_relaxed);
+			// 数据读取不能被重排到第二次读序号之后
+			std::atomic_thread_fence(std::memory_order_acquire);
+		} while ((begin & 1) || sequence.load(std::memory_order_relaxed) != begin);
+
+		if (pts_us == AV_NOPTS_VALUE || now_us - updated_us > max_age_us) {
+			return AV_NOPTS_VALUE;
+		}
+		return pts_us + (int64_t)((now_us - updated_us) * clock_rate);
+	}
+};
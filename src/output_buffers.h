@@ -0,0 +1,131 @@
+// Copyright (c) 2025 Anders Xiao. All rights reserved.
+// https://github.com/endink
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+extern "C" {
+	#include <libavutil/buffer.h>
+	#include <libavutil/frame.h>
+}
+
+/*
+  调用者注册的输出缓冲（例如引擎映射的上传缓冲），解码线程的 sws_scale 直接写入其中。
+  一块缓冲有两个持有者：写入它的帧（最后一个 AVFrame 引用释放为止）和调用者（交付后到 ReleaseOutputBuffer 为止），
+  两者都放手后才排到空闲队列末尾，按释放的先后顺序轮流借出，引擎还在上传的缓冲不会被覆盖。
+  全部被占用时 Acquire 失败，调用方退回内部缓冲。只在播放器关闭时注册 / 替换，Close 会释放所有帧引用。
+*/
+struct OutputBufferSet {
+	struct Entry {
+		OutputBufferSet* Owner = nullptr;
+		int Index = 0;
+		bool FrameHeld = false;   // 有帧引用，受 mutex 保护
+		bool CallerHeld = false;  // 已交付给调用者、尚未 ReleaseOutputBuffer
+	};
+
+	std::vector<uint8_t*> Buffers;
+	std::vector<Entry> Entries;     // av_buffer_create 的 opaque
+	int Pitch = 0;
+	int Height = 0;
+
+	std::mutex mutex;
+	std::vector<int> freeRing;      // 空闲缓冲的下标，head 为最早释放的
+	int freeHead = 0;
+	int freeCount = 0;
+
+	OutputBufferSet(uint8_t* const* buffers, int count, int pitch, int height)
+		: Buffers(buffers, buffers + count), Entries(count), Pitch(pitch), Height(height), freeRing(count), freeCount(count)
+	{
+		for (int i = 0; i < count; i++) {
+			Entries[i].Owner = this;
+			Entries[i].Index = i;
+			freeRing[i] = i;
+		}
+	}
+
+	OutputBufferSet(const OutputBufferSet&) = delete;
+	OutputBufferSet& operator=(const OutputBufferSet&) = delete;
+
+	// 一行 4 字节像素的 width x height 图像能否放进注册的缓冲
+	bool Fits(int width, int height) const {
+		return width > 0 && height > 0 && (int64_t)width * 4 <= Pitch && height <= Height;
+	}
+
+	// 借出最早空闲的缓冲并挂到 frame 上（frame 必须为空），返回缓冲下标，全部被占用时返回 -1
+	int Acquire(AVFrame* frame, int width, int height, AVPixelFormat format) {
+		int index;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (freeCount == 0) {
+				return -1;
+			}
+			index = freeRing[freeHead];
+			freeHead = (freeHead + 1) % (int)freeRing.size();
+			freeCount--;
+			Entries[index].FrameHeld = true;
+		}
+
+		frame->buf[0] = av_buffer_create(Buffers[index], (size_t)Pitch * Height, &OutputBufferSet::FreeBuffer, &Entries[index], 0);
+		if (!frame->buf[0]) {
+			std::lock_guard<std::mutex> lock(mutex);
+			Entries[index].FrameHeld = false;
+			PushFreeLocked(index);
+			return -1;
+		}
+		frame->data[0] = Buffers[index];
+		frame->linesize[0] = Pitch;
+		frame->extended_data = frame->data;
+		frame->width = width;
+		frame->height = height;
+		frame->format = format;
+		return index;
+	}
+
+	// present thread: 帧交付给调用者，缓冲在 Release 之前不再借出
+	void Hold(int index) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (index >= 0 && index < (int)Entries.size() && Entries[index].FrameHeld) {
+			Entries[index].CallerHeld = true;
+		}
+	}
+
+	// 调用者用完缓冲（例如 GPU 上传已完成），重复释放或未交付的下标返回 false
+	bool Release(int index) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (index < 0 || index >= (int)Entries.size() || !Entries[index].CallerHeld) {
+			return false;
+		}
+		Entries[index].CallerHeld = false;
+		if (!Entries[index].FrameHeld) {
+			PushFreeLocked(index);
+		}
+		return true;
+	}
+
+	// Close：调用者持有的缓冲全部收回，下次 Open 重新轮转
+	void ReleaseAll() {
+		for (int i = 0; i < (int)Entries.size(); i++) {
+			Release(i);
+		}
+	}
+
+private:
+	void PushFreeLocked(int index) {
+		freeRing[(freeHead + freeCount) % (int)freeRing.size()] = index;
+		freeCount++;
+	}
+
+	// 帧的最后一个引用释放（任意线程），内存属于调用者，不释放
+	static void FreeBuffer(void* opaque, uint8_t* data) {
+		(void)data;
+		auto* entry = static_cast<Entry*>(opaque);
+		OutputBufferSet* owner = entry->Owner;
+		std::lock_guard<std::mutex> lock(owner->mutex);
+		entry->FrameHeld = false;
+		if (!entry->CallerHeld) {
+			owner->PushFreeLocked(entry->Index);
+		}
+	}
+};
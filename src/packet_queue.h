@@ -0,0 +1,231 @@
+// Copyright (c) 2025 Anders Xiao. All rights reserved.
+// https://github.com/endink
+
+#pragma once
+
+extern "C" {
+    #include <libavcodec/avcodec.h>
+    #include <libavutil/avutil.h>
+    }
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+const int64_t kDefaultPacketQueueMaxBytes = 64 * 1024 * 1024;
+const int64_t kDefaultPacketQueueMaxUS = 3 * 1000000;
+// 队列中包数少于该值时不按时长判满，避免 duration 缺失/异常时饿死解码线程
+const int kPacketQueueMinPackets = 25;
+
+struct QueuedPacket {
+    AVPacket* Packet = nullptr;   // nullptr 表示流结束标记（EOF）
+    int Serial = 0;
+};
+
+/*
+  demux 线程与解码线程之间的有界包队列，按字节数和时长双重限流。
+  Serial 在 Flush 时递增，消费者据此判断包是否属于 seek/loop 之前的旧序列。
+  出队的 AVPacket 外壳经 Recycle 回到空闲列表，稳定播放时入队不再分配。
+*/
+struct PacketQueue {
+    std::deque<QueuedPacket> packets;
+    std::mutex mutex;
+    std::condition_variable cond;
+    // 已 unref 的空包，Put 优先复用
+    std::vector<AVPacket*> freePackets;
+
+    int64_t sizeInBytes = 0;
+    int64_t durationUS = 0;
+    int64_t maxBytes = kDefaultPacketQueueMaxBytes;
+    int64_t maxDurationUS = kDefaultPacketQueueMaxUS;
+    // 包未携带 duration 时使用的估计值
+    int64_t defaultPacketDurationUS = 0;
+    AVRational timebase{ 1, AV_TIME_BASE };
+
+    std::atomic<int> serial{ 0 };
+    bool aborted = false;
+    bool wakeupRequested = false;
+
+    PacketQueue() = default;
+    PacketQueue(const PacketQueue&) = delete;
+    PacketQueue& operator=(const PacketQueue&) = delete;
+
+    ~PacketQueue() {
+        Flush();
+        for (auto& packet : freePackets) {
+            av_packet_free(&packet);
+        }
+    }
+
+    void Configure(AVRational streamTimebase, int64_t frameDurationUS, int64_t maxQueueBytes, int64_t maxQueueDurationUS) {
+        std::lock_guard<std::mutex> lock(mutex);
+        timebase = streamTimebase;
+        defaultPacketDurationUS = frameDurationUS;
+        maxBytes = maxQueueBytes > 0 ? maxQueueBytes : kDefaultPacketQueueMaxBytes;
+        maxDurationUS = maxQueueDurationUS > 0 ? maxQueueDurationUS : kDefaultPacketQueueMaxUS;
+    }
+
+    // 接管 packet 的引用（调用后 packet 被重置为空包）
+    bool Put(AVPacket* packet) {
+        AVPacket* owned = AcquirePacket();
+        if (!owned) {
+            av_packet_unref(packet);
+            return false;
+        }
+        av_packet_move_ref(owned, packet);
+        return PutInternal(owned);
+    }
+
+    bool PutEndOfStream() {
+        return PutInternal(nullptr);
+    }
+
+    /*
+      取出一个包，返回 1 表示取到（out 为 nullptr 表示 EOF 标记），0 表示非阻塞模式下队列为空，-1 表示已中止。
+      取到的 AVPacket 由调用方用完后交给 Recycle。
+    */
+    int Get(QueuedPacket& out, bool block) {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            if (aborted) {
+                return -1;
+            }
+            if (!packets.empty()) {
+                out = packets.front();
+                packets.pop_front();
+                if (out.Packet) {
+                    sizeInBytes -= PacketBytes(out.Packet);
+                    durationUS -= PacketDurationUS(out.Packet);
+                }
+                cond.notify_all();
+                return 1;
+            }
+            if (!block) {
+                return 0;
+            }
+            cond.wait(lock);
+        }
+    }
+
+    /*
+      demux 线程在队列满时等待，直到有空间、被 Wakeup 唤醒或超时。
+      返回 true 表示可以继续写入。
+    */
+    bool WaitForSpace(int timeoutMills) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait_for(lock, std::chrono::milliseconds(timeoutMills), [this] {
+            return aborted || wakeupRequested || !IsFullLocked();
+        });
+        wakeupRequested = false;
+        return !aborted && !IsFullLocked();
+    }
+
+    // 非阻塞判满，供共享调度器模式下的 demux 使用
+    bool IsFull() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return IsFullLocked();
+    }
+
+    // 唤醒在 WaitForSpace 中等待的 demux 线程（例如有新的控制命令）
+    void Wakeup() {
+        std::lock_guard<std::mutex> lock(mutex);
+        wakeupRequested = true;
+        cond.notify_all();
+    }
+
+    // 释放包数据并把外壳放回空闲列表，packet 被置为 nullptr
+    void Recycle(AVPacket*& packet) {
+        if (!packet) {
+            return;
+        }
+        av_packet_unref(packet);
+        std::lock_guard<std::mutex> lock(mutex);
+        freePackets.push_back(packet);
+        packet = nullptr;
+    }
+
+    void Flush() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& item : packets) {
+            if (item.Packet) {
+                av_packet_unref(item.Packet);
+                freePackets.push_back(item.Packet);
+            }
+        }
+        packets.clear();
+        sizeInBytes = 0;
+        durationUS = 0;
+        serial++;
+        cond.notify_all();
+    }
+
+    void Abort() {
+        std::lock_guard<std::mutex> lock(mutex);
+        aborted = true;
+        cond.notify_all();
+    }
+
+    void Start() {
+        std::lock_guard<std::mutex> lock(mutex);
+        aborted = false;
+    }
+
+    // 无锁读取，供呈现线程判断帧是否已过期
+    int Serial() const {
+        return serial.load(std::memory_order_acquire);
+    }
+
+private:
+    AVPacket* AcquirePacket() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!freePackets.empty()) {
+                AVPacket* packet = freePackets.back();
+                freePackets.pop_back();
+                return packet;
+            }
+        }
+        return av_packet_alloc();
+    }
+
+    bool PutInternal(AVPacket* packet) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (aborted) {
+            if (packet) {
+                av_packet_unref(packet);
+                freePackets.push_back(packet);
+            }
+            return false;
+        }
+        QueuedPacket item;
+        item.Packet = packet;
+        item.Serial = serial.load(std::memory_order_relaxed);
+        packets.push_back(item);
+        if (packet) {
+            sizeInBytes += PacketBytes(packet);
+            durationUS += PacketDurationUS(packet);
+        }
+        cond.notify_all();
+        return true;
+    }
+
+    bool IsFullLocked() const {
+        if (sizeInBytes >= maxBytes) {
+            return true;
+        }
+        return packets.size() > kPacketQueueMinPackets && durationUS >= maxDurationUS;
+    }
+
+    static int64_t PacketBytes(const AVPacket* packet) {
+        return packet->size + (int64_t)sizeof(AVPacket);
+    }
+
+    int64_t PacketDurationUS(const AVPacket* packet) const {
+        if (packet->duration > 0) {
+            return av_rescale_q(packet->duration, timebase, AVRational{ 1, AV_TIME_BASE });
+        }
+        return defaultPacketDurationUS;
+    }
+};
@@ -0,0 +1,106 @@
+// Copyright (c) 2025 Anders Xiao. All rights reserved.
+// https://github.com/endink
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+/*
+  单生产者 / 单消费者的无锁 PCM 环形缓冲（字节）。
+  音频解码线程 Write，引擎音频线程 Read；读写只有 memcpy 和原子操作，不分配内存、不加锁。
+  读写位置单调递增，容量为 2 的幂，下标取模即可。
+*/
+struct PcmRingBuffer {
+	std::vector<uint8_t> buffer;
+	size_t mask = 0;
+	std::atomic<uint64_t> writePos{ 0 };
+	std::atomic<uint64_t> readPos{ 0 };
+	// seek 时由生产者侧推进，消费者读取前跳过该位置之前的旧数据
+	std::atomic<uint64_t> discardPos{ 0 };
+
+	PcmRingBuffer() = default;
+	PcmRingBuffer(const PcmRingBuffer&) = delete;
+	PcmRingBuffer& operator=(const PcmRingBuffer&) = delete;
+
+	// 读写线程都未运行时调用
+	void Init(size_t minCapacity) {
+		size_t capacity = 1;
+		while (capacity < minCapacity) capacity <<= 1;
+		buffer.assign(capacity, 0);
+		mask = capacity - 1;
+		writePos = 0;
+		readPos = 0;
+		discardPos = 0;
+	}
+
+	size_t Capacity() const {
+		return buffer.size();
+	}
+
+	// producer
+	size_t AvailableToWrite() const {
+		return Capacity() - (size_t)(writePos.load(std::memory_order_relaxed) - readPos.load(std::memory_order_acquire));
+	}
+
+	// 只写入 alignment 的整数倍，保证读写位置始终落在采样帧边界
+	size_t Write(const uint8_t* data, size_t bytes, size_t alignment) {
+		uint64_t w = writePos.load(std::memory_order_relaxed);
+		bytes = std::min(bytes, AvailableToWrite());
+		if (alignment > 1) bytes -= bytes % alignment;
+		CopyIn(w, data, bytes);
+		writePos.store(w + bytes, std::memory_order_release);
+		return bytes;
+	}
+
+	// 丢弃已写入但尚未读取的数据，可在任意线程调用
+	void DiscardPending() {
+		uint64_t target = writePos.load(std::memory_order_acquire);
+		uint64_t current = discardPos.load(std::memory_order_relaxed);
+		while (current < target && !discardPos.compare_exchange_weak(current, target, std::memory_order_release)) {}
+	}
+
+	// consumer
+	size_t AvailableToRead() {
+		SkipDiscarded();
+		return (size_t)(writePos.load(std::memory_order_acquire) - readPos.load(std::memory_order_relaxed));
+	}
+
+	// 只读取 alignment（一个采样帧的字节数）的整数倍
+	size_t Read(uint8_t* out, size_t bytes, size_t alignment) {
+		size_t available = AvailableToRead();
+		bytes = std::min(bytes, available);
+		if (alignment > 1) bytes -= bytes % alignment;
+
+		uint64_t r = readPos.load(std::memory_order_relaxed);
+		CopyOut(r, out, bytes);
+		readPos.store(r + bytes, std::memory_order_release);
+		return bytes;
+	}
+
+private:
+	void SkipDiscarded() {
+		uint64_t discard = discardPos.load(std::memory_order_acquire);
+		uint64_t r = readPos.load(std::memory_order_relaxed);
+		if (discard > r) {
+			readPos.store(discard, std::memory_order_release);
+		}
+	}
+
+	void CopyIn(uint64_t pos, const uint8_t* data, size_t bytes) {
+		size_t offset = (size_t)(pos & mask);
+		size_t first = std::min(bytes, Capacity() - offset);
+		memcpy(buffer.data() + offset, data, first);
+		memcpy(buffer.data(), data + first, bytes - first);
+	}
+
+	void CopyOut(uint64_t pos, uint8_t* out, size_t bytes) const {
+		size_t offset = (size_t)(pos & mask);
+		size_t first = std::min(bytes, Capacity() - offset);
+		memcpy(out, buffer.data() + offset, first);
+		memcpy(out + first, buffer.data(), bytes - first);
+	}
+};
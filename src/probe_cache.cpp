@@ -0,0 +1,440 @@
+// Copyright (c) 2025 Anders Xiao. All rights reserved.
+// https://github.com/endink
+
+#include "probe_cache.h"
+#include "commons.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+#include <thread>
+extern "C" {
+	#include <libavutil/avstring.h>
+}
+
+// 文件格式变化时递增，旧缓存直接失效
+const uint32_t kProbeCacheMagic = 0x43505056; // "VPPC"
+const uint32_t kProbeCacheVersion = 2; // 2: 容器索引的关键帧时间换算为 PTS
+const uint32_t kMaxCachedStreams = 1024;
+const uint32_t kMaxCachedExtradata = 16 * 1024 * 1024;
+
+// 这些 demuxer 从文件头就能得到完整的解码参数，avformat_find_stream_info 不会建立后续读包依赖的状态；
+// 其余格式（ts / ps / flv 裸流等）命中缓存也仍然要探测，缓存只提供解码测速和关键帧索引
+const char* const kStreamInfoSkippableDemuxers[] = { "mov", "matroska" };
+
+namespace fs = std::filesystem;
+
+// 缓存只在本机使用，按本机字节序写入 POD 字段
+struct CacheWriter {
+	std::string Data;
+
+	template<typename T>
+	void Put(const T& value) {
+		Data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	void PutBytes(const void* data, size_t size) {
+		Put((uint32_t)size);
+		Data.append(reinterpret_cast<const char*>(data), size);
+	}
+};
+
+struct CacheReader {
+	const std::string& Data;
+	size_t Pos = 0;
+	bool Ok = true;
+
+	explicit CacheReader(const std::string& data) : Data(data) {}
+
+	template<typename T>
+	T Get() {
+		T value{};
+		if (!Ok || Pos + sizeof(T) > Data.size()) {
+			Ok = false;
+			return value;
+		}
+		memcpy(&value, Data.data() + Pos, sizeof(T));
+		Pos += sizeof(T);
+		return value;
+	}
+
+	void GetBytes(std::vector<uint8_t>& out, uint32_t maxSize) {
+		uint32_t size = Get<uint32_t>();
+		if (!Ok || size > maxSize || Pos + size > Data.size()) {
+			Ok = false;
+			return;
+		}
+		out.assign(Data.begin() + Pos, Data.begin() + Pos + size);
+		Pos += size;
+	}
+};
+
+static uint64_t HashKey(const std::string& file, int64_t size, int64_t time)
+{
+	// FNV-1a
+	uint64_t hash = 1469598103934665603ULL;
+	auto mix = [&hash](const void* data, size_t len) {
+		const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < len; i++) {
+			hash ^= p[i];
+			hash *= 1099511628211ULL;
+		}
+	};
+	mix(file.data(), file.size());
+	mix(&size, sizeof(size));
+	mix(&time, sizeof(time));
+	return hash;
+}
+
+ProbeCache::ProbeCache(const std::string& directory, const std::string& file)
+	: file(file)
+{
+	if (directory.empty() || file.empty()) return;
+
+	std::error_code ec;
+	fs::path path = fs::u8path(file);
+	fileSize = (int64_t)fs::file_size(path, ec);
+	if (ec) return;
+	fileTime = (int64_t)fs::last_write_time(path, ec).time_since_epoch().count();
+	if (ec) return;
+
+	fs::path dir = fs::u8path(directory);
+	fs::create_directories(dir, ec);
+	if (ec) {
+		LogWarning("Probe cache directory unavailable: %s", directory.c_str());
+		return;
+	}
+
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.vpcache", (unsigned long long)HashKey(file, fileSize, fileTime));
+	cachePath = (dir / name).u8string();
+}
+
+bool ProbeCache::Load(ProbeCacheEntry& entry) const
+{
+	if (!Enabled()) return false;
+
+	std::ifstream input(fs::u8path(cachePath), std::ios::binary);
+	if (!input.is_open()) return false;
+	std::string data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+	CacheReader r(data);
+	if (r.Get<uint32_t>() != kProbeCacheMagic || r.Get<uint32_t>() != kProbeCacheVersion) return false;
+
+	std::vector<uint8_t> path;
+	r.GetBytes(path, 64 * 1024);
+	int64_t size = r.Get<int64_t>();
+	int64_t time = r.Get<int64_t>();
+	if (!r.Ok || std::string(path.begin(), path.end()) != file || size != fileSize || time != fileTime) {
+		// 哈希冲突或文件已变化
+		return false;
+	}
+
+	ProbeCacheEntry e;
+	e.FormatStartTime = r.Get<int64_t>();
+	e.FormatDuration = r.Get<int64_t>();
+	e.FormatBitRate = r.Get<int64_t>();
+
+	uint32_t streams = r.Get<uint32_t>();
+	if (!r.Ok || streams > kMaxCachedStreams) return false;
+	e.Streams.resize(streams);
+	for (auto& s : e.Streams) {
+		s.CodecType = r.Get<int32_t>();
+		s.CodecId = r.Get<int32_t>();
+		s.CodecTag = r.Get<uint32_t>();
+		s.Format = r.Get<int32_t>();
+		s.BitRate = r.Get<int64_t>();
+		s.BitsPerCodedSample = r.Get<int32_t>();
+		s.BitsPerRawSample = r.Get<int32_t>();
+		s.Profile = r.Get<int32_t>();
+		s.Level = r.Get<int32_t>();
+		s.Width = r.Get<int32_t>();
+		s.Height = r.Get<int32_t>();
+		s.SampleAspectRatio = r.Get<AVRational>();
+		s.FieldOrder = r.Get<int32_t>();
+		s.ColorRange = r.Get<int32_t>();
+		s.ColorPrimaries = r.Get<int32_t>();
+		s.ColorTrc = r.Get<int32_t>();
+		s.ColorSpace = r.Get<int32_t>();
+		s.ChromaLocation = r.Get<int32_t>();
+		s.VideoDelay = r.Get<int32_t>();
+		s.ChannelOrder = r.Get<int32_t>();
+		s.Channels = r.Get<int32_t>();
+		s.ChannelMask = r.Get<uint64_t>();
+		s.SampleRate = r.Get<int32_t>();
+		s.BlockAlign = r.Get<int32_t>();
+		s.FrameSize = r.Get<int32_t>();
+		s.InitialPadding = r.Get<int32_t>();
+		s.TrailingPadding = r.Get<int32_t>();
+		s.SeekPreroll = r.Get<int32_t>();
+		r.GetBytes(s.Extradata, kMaxCachedExtradata);
+		s.TimeBase = r.Get<AVRational>();
+		s.AvgFrameRate = r.Get<AVRational>();
+		s.RFrameRate = r.Get<AVRational>();
+		s.StartTime = r.Get<int64_t>();
+		s.Duration = r.Get<int64_t>();
+		s.FrameCount = r.Get<int64_t>();
+	}
+
+	e.DecoderFPS = r.Get<double>();
+	e.KeyFrameGapTime = r.Get<int64_t>();
+	e.KeyFrameSource = r.Get<int32_t>();
+	e.KeyFramesComplete = r.Get<uint8_t>() != 0;
+	uint32_t keys = r.Get<uint32_t>();
+	if (!r.Ok || (size_t)keys * (sizeof(int64_t) * 2 + sizeof(int32_t)) > data.size() - r.Pos) return false;
+	e.KeyFrames.resize(keys);
+	for (auto& k : e.KeyFrames) {
+		k.PtsUS = r.Get<int64_t>();
+		k.Pos = r.Get<int64_t>();
+		k.GopSize = r.Get<int32_t>();
+	}
+	if (!r.Ok) {
+		LogWarning("Probe cache corrupted: %s", cachePath.c_str());
+		return false;
+	}
+
+	entry = std::move(e);
+	return true;
+}
+
+bool ProbeCache::Save(const ProbeCacheEntry& entry) const
+{
+	if (!Enabled()) return false;
+
+	CacheWriter w;
+	w.Put(kProbeCacheMagic);
+	w.Put(kProbeCacheVersion);
+	w.PutBytes(file.data(), file.size());
+	w.Put(fileSize);
+	w.Put(fileTime);
+
+	w.Put(entry.FormatStartTime);
+	w.Put(entry.FormatDuration);
+	w.Put(entry.FormatBitRate);
+	w.Put((uint32_t)entry.Streams.size());
+	for (auto& s : entry.Streams) {
+		w.Put((int32_t)s.CodecType);
+		w.Put((int32_t)s.CodecId);
+		w.Put(s.CodecTag);
+		w.Put((int32_t)s.Format);
+		w.Put(s.BitRate);
+		w.Put((int32_t)s.BitsPerCodedSample);
+		w.Put((int32_t)s.BitsPerRawSample);
+		w.Put((int32_t)s.Profile);
+		w.Put((int32_t)s.Level);
+		w.Put((int32_t)s.Width);
+		w.Put((int32_t)s.Height);
+		w.Put(s.SampleAspectRatio);
+		w.Put((int32_t)s.FieldOrder);
+		w.Put((int32_t)s.ColorRange);
+		w.Put((int32_t)s.ColorPrimaries);
+		w.Put((int32_t)s.ColorTrc);
+		w.Put((int32_t)s.ColorSpace);
+		w.Put((int32_t)s.ChromaLocation);
+		w.Put((int32_t)s.VideoDelay);
+		w.Put((int32_t)s.ChannelOrder);
+		w.Put((int32_t)s.Channels);
+		w.Put(s.ChannelMask);
+		w.Put((int32_t)s.SampleRate);
+		w.Put((int32_t)s.BlockAlign);
+		w.Put((int32_t)s.FrameSize);
+		w.Put((int32_t)s.InitialPadding);
+		w.Put((int32_t)s.TrailingPadding);
+		w.Put((int32_t)s.SeekPreroll);
+		w.PutBytes(s.Extradata.data(), s.Extradata.size());
+		w.Put(s.TimeBase);
+		w.Put(s.AvgFrameRate);
+		w.Put(s.RFrameRate);
+		w.Put(s.StartTime);
+		w.Put(s.Duration);
+		w.Put(s.FrameCount);
+	}
+
+	w.Put(entry.DecoderFPS);
+	w.Put(entry.KeyFrameGapTime);
+	w.Put((int32_t)entry.KeyFrameSource);
+	w.Put((uint8_t)(entry.KeyFramesComplete ? 1 : 0));
+	w.Put((uint32_t)entry.KeyFrames.size());
+	for (auto& k : entry.KeyFrames) {
+		w.Put(k.PtsUS);
+		w.Put(k.Pos);
+		w.Put(k.GopSize);
+	}
+
+	fs::path target = fs::u8path(cachePath);
+	fs::path temp = target;
+	char suffix[32];
+	snprintf(suffix, sizeof(suffix), ".%zx.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()));
+	temp += suffix;
+	{
+		std::ofstream output(temp, std::ios::binary | std::ios::trunc);
+		if (!output.is_open()) {
+			LogWarning("Failed to write probe cache: %s", cachePath.c_str());
+			return false;
+		}
+		output.write(w.Data.data(), (std::streamsize)w.Data.size());
+		if (!output.good()) {
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	fs::rename(temp, target, ec);
+	if (ec) {
+		fs::remove(temp, ec);
+		return false;
+	}
+	LogDebug("Probe cache saved: %s", cachePath.c_str());
+	return true;
+}
+
+void ProbeCache::Capture(const AVFormatContext* fmt, ProbeCacheEntry& entry)
+{
+	entry.FormatStartTime = fmt->start_time;
+	entry.FormatDuration = fmt->duration;
+	entry.FormatBitRate = fmt->bit_rate;
+	entry.Streams.clear();
+	entry.Streams.resize(fmt->nb_streams);
+	for (unsigned int i = 0; i < fmt->nb_streams; i++) {
+		const AVStream* st = fmt->streams[i];
+		const AVCodecParameters* cp = st->codecpar;
+		auto& s = entry.Streams[i];
+		s.CodecType = cp->codec_type;
+		s.CodecId = cp->codec_id;
+		s.CodecTag = cp->codec_tag;
+		s.Format = cp->format;
+		s.BitRate = cp->bit_rate;
+		s.BitsPerCodedSample = cp->bits_per_coded_sample;
+		s.BitsPerRawSample = cp->bits_per_raw_sample;
+		s.Profile = cp->profile;
+		s.Level = cp->level;
+		s.Width = cp->width;
+		s.Height = cp->height;
+		s.SampleAspectRatio = cp->sample_aspect_ratio;
+		s.FieldOrder = cp->field_order;
+		s.ColorRange = cp->color_range;
+		s.ColorPrimaries = cp->color_primaries;
+		s.ColorTrc = cp->color_trc;
+		s.ColorSpace = cp->color_space;
+		s.ChromaLocation = cp->chroma_location;
+		s.VideoDelay = cp->video_delay;
+		s.ChannelOrder = cp->ch_layout.order;
+		s.Channels = cp->ch_layout.nb_channels;
+		s.ChannelMask = cp->ch_layout.order == AV_CHANNEL_ORDER_NATIVE ? cp->ch_layout.u.mask : 0;
+		s.SampleRate = cp->sample_rate;
+		s.BlockAlign = cp->block_align;
+		s.FrameSize = cp->frame_size;
+		s.InitialPadding = cp->initial_padding;
+		s.TrailingPadding = cp->trailing_padding;
+		s.SeekPreroll = cp->seek_preroll;
+		s.Extradata.assign(cp->extradata, cp->extradata + std::max(cp->extradata_size, 0));
+		s.TimeBase = st->time_base;
+		s.AvgFrameRate = st->avg_frame_rate;
+		s.RFrameRate = st->r_frame_rate;
+		s.StartTime = st->start_time;
+		s.Duration = st->duration;
+		s.FrameCount = st->nb_frames;
+	}
+}
+
+bool ProbeCache::Matches(const ProbeCacheEntry& entry, const AVFormatContext* fmt)
+{
+	if (fmt->nb_streams != entry.Streams.size()) {
+		return false;
+	}
+	for (unsigned int i = 0; i < fmt->nb_streams; i++) {
+		const AVStream* st = fmt->streams[i];
+		const auto& s = entry.Streams[i];
+		if (st->codecpar->codec_type != s.CodecType) return false;
+		if (st->codecpar->codec_id != AV_CODEC_ID_NONE && st->codecpar->codec_id != s.CodecId) return false;
+		if (st->time_base.num > 0 && av_cmp_q(st->time_base, s.TimeBase) != 0) return false;
+	}
+	return true;
+}
+
+bool ProbeCache::CanSkipStreamInfo(const AVFormatContext* fmt)
+{
+	const char* name = fmt->iformat ? fmt->iformat->name : nullptr;
+	if (!name) {
+		return false;
+	}
+	for (const char* allowed : kStreamInfoSkippableDemuxers) {
+		if (av_match_name(allowed, name)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ProbeCache::Apply(const ProbeCacheEntry& entry, AVFormatContext* fmt)
+{
+	// 先整体校验，避免改了一半再回退到 avformat_find_stream_info
+	if (!Matches(entry, fmt)) {
+		return false;
+	}
+
+	for (unsigned int i = 0; i < fmt->nb_streams; i++) {
+		AVStream* st = fmt->streams[i];
+		AVCodecParameters* cp = st->codecpar;
+		const auto& s = entry.Streams[i];
+
+		uint8_t* extradata = nullptr;
+		if (!s.Extradata.empty()) {
+			extradata = reinterpret_cast<uint8_t*>(av_mallocz(s.Extradata.size() + AV_INPUT_BUFFER_PADDING_SIZE));
+			if (!extradata) return false;
+			memcpy(extradata, s.Extradata.data(), s.Extradata.size());
+		}
+		av_freep(&cp->extradata);
+		cp->extradata = extradata;
+		cp->extradata_size = (int)s.Extradata.size();
+
+		cp->codec_id = static_cast<AVCodecID>(s.CodecId);
+		cp->codec_tag = s.CodecTag;
+		cp->format = s.Format;
+		cp->bit_rate = s.BitRate;
+		cp->bits_per_coded_sample = s.BitsPerCodedSample;
+		cp->bits_per_raw_sample = s.BitsPerRawSample;
+		cp->profile = s.Profile;
+		cp->level = s.Level;
+		cp->width = s.Width;
+		cp->height = s.Height;
+		cp->sample_aspect_ratio = s.SampleAspectRatio;
+		cp->field_order = static_cast<decltype(cp->field_order)>(s.FieldOrder);
+		cp->color_range = static_cast<decltype(cp->color_range)>(s.ColorRange);
+		cp->color_primaries = static_cast<decltype(cp->color_primaries)>(s.ColorPrimaries);
+		cp->color_trc = static_cast<decltype(cp->color_trc)>(s.ColorTrc);
+		cp->color_space = static_cast<decltype(cp->color_space)>(s.ColorSpace);
+		cp->chroma_location = static_cast<decltype(cp->chroma_location)>(s.ChromaLocation);
+		cp->video_delay = s.VideoDelay;
+		av_channel_layout_uninit(&cp->ch_layout);
+		if (s.ChannelOrder == AV_CHANNEL_ORDER_NATIVE) {
+			cp->ch_layout.order = AV_CHANNEL_ORDER_NATIVE;
+			cp->ch_layout.nb_channels = s.Channels;
+			cp->ch_layout.u.mask = s.ChannelMask;
+		}
+		else if (s.Channels > 0) {
+			av_channel_layout_default(&cp->ch_layout, s.Channels);
+		}
+		cp->sample_rate = s.SampleRate;
+		cp->block_align = s.BlockAlign;
+		cp->frame_size = s.FrameSize;
+		cp->initial_padding = s.InitialPadding;
+		cp->trailing_padding = s.TrailingPadding;
+		cp->seek_preroll = s.SeekPreroll;
+
+		st->avg_frame_rate = s.AvgFrameRate;
+		st->r_frame_rate = s.RFrameRate;
+		st->start_time = s.StartTime;
+		st->duration = s.Duration;
+		st->nb_frames = s.FrameCount;
+	}
+
+	fmt->start_time = entry.FormatStartTime;
+	fmt->duration = entry.FormatDuration;
+	fmt->bit_rate = entry.FormatBitRate;
+	return true;
+}
@@ -0,0 +1,99 @@
+// Copyright (c) 2025 Anders Xiao. All rights reserved.
+// https://github.com/endink
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+extern "C" {
+	#include <libavformat/avformat.h>
+}
+#include "keyframe_index.h"
+
+struct ProbeCacheStream {
+	int CodecType = AVMEDIA_TYPE_UNKNOWN;
+	int CodecId = AV_CODEC_ID_NONE;
+	uint32_t CodecTag = 0;
+	int Format = -1;
+	int64_t BitRate = 0;
+	int BitsPerCodedSample = 0;
+	int BitsPerRawSample = 0;
+	int Profile = 0;
+	int Level = 0;
+	int Width = 0;
+	int Height = 0;
+	AVRational SampleAspectRatio{ 0, 1 };
+	int FieldOrder = 0;
+	int ColorRange = 0;
+	int ColorPrimaries = 0;
+	int ColorTrc = 0;
+	int ColorSpace = 0;
+	int ChromaLocation = 0;
+	int VideoDelay = 0;
+	int ChannelOrder = 0;
+	int Channels = 0;
+	uint64_t ChannelMask = 0;
+	int SampleRate = 0;
+	int BlockAlign = 0;
+	int FrameSize = 0;
+	int InitialPadding = 0;
+	int TrailingPadding = 0;
+	int SeekPreroll = 0;
+	std::vector<uint8_t> Extradata;
+
+	AVRational TimeBase{ 0, 1 };
+	AVRational AvgFrameRate{ 0, 1 };
+	AVRational RFrameRate{ 0, 1 };
+	int64_t StartTime = AV_NOPTS_VALUE;
+	int64_t Duration = AV_NOPTS_VALUE;
+	int64_t FrameCount = 0;
+};
+
+/*
+  一个文件的探测结果：avformat_find_stream_info 得到的流参数、测得的解码速度和关键帧索引。
+  命中时 Open 跳过 avformat_find_stream_info / GetKeyFrameInterval / GetDecoderFPS / 关键帧扫描。
+*/
+struct ProbeCacheEntry {
+	int64_t FormatStartTime = AV_NOPTS_VALUE;
+	int64_t FormatDuration = AV_NOPTS_VALUE;
+	int64_t FormatBitRate = 0;
+	std::vector<ProbeCacheStream> Streams;
+
+	double DecoderFPS = 0;
+	int64_t KeyFrameGapTime = 0;
+	int KeyFrameSource = 0;
+	bool KeyFramesComplete = false;
+	std::vector<KeyFrameEntry> KeyFrames;
+};
+
+/*
+  磁盘上的探测缓存，每个文件一个 sidecar，文件名由路径、大小和修改时间决定，
+  文件内容再次校验这三项，文件被替换后旧缓存自然失效。
+*/
+class ProbeCache {
+public:
+	// directory 为空时不启用
+	ProbeCache(const std::string& directory, const std::string& file);
+
+	bool Enabled() const { return !cachePath.empty(); }
+
+	bool Load(ProbeCacheEntry& entry) const;
+	// 先写临时文件再改名，多个进程同时写同一个缓存也不会读到半个文件
+	bool Save(const ProbeCacheEntry& entry) const;
+
+	// avformat_find_stream_info 之后的流参数
+	static void Capture(const AVFormatContext* fmt, ProbeCacheEntry& entry);
+	// 流数量、类型、编码与 demuxer 从文件头读到的一致
+	static bool Matches(const ProbeCacheEntry& entry, const AVFormatContext* fmt);
+	// 缓存能否完全代替 avformat_find_stream_info：只有文件头已带齐解码参数、不依赖探测时建立的 parser 状态的 demuxer（mov/mp4、matroska）
+	static bool CanSkipStreamInfo(const AVFormatContext* fmt);
+	// avformat_open_input 之后、代替 avformat_find_stream_info；不一致时返回 false
+	static bool Apply(const ProbeCacheEntry& entry, AVFormatContext* fmt);
+
+private:
+	std::string file;
+	std::string cachePath;
+	int64_t fileSize = -1;
+	int64_t fileTime = 0;
+};
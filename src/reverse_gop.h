@@ -0,0 +1,139 @@
+// Copyright (c) 2025 Anders Xiao. All rights reserved.
+// https://github.com/endink
+
+#pragma once
+
+#include "frame_queue.h"
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+const int kDefaultReverseCacheFrames = 64;
+// 两个缓存合计的像素内存上限
+const int64_t kDefaultReverseCacheMaxBytes = 1024LL * 1024 * 1024;
+
+/*
+  倒放缓存：一个 GOP 正向解码后的已转换帧（按 pts 递增写入），交付时从最新的一帧开始倒序取出。
+  GOP 比当前容量长时按需增长到 maxFrames（由字节上限换算），超过上限才丢弃最早的帧（倒放时最后才显示）。
+  槽位的 AVFrame 在交付时与帧队列槽位交换，不拷贝像素。
+*/
+struct ReverseGop {
+    std::vector<QueuedFrame> frames;
+    int start = 0;
+    int count = 0;
+    int64_t FirstPtsUS = AV_NOPTS_VALUE;  // GOP 中解码出的最早 pts（包括因容量丢弃的帧）
+    bool Complete = false;                // GOP 已解码完，等待 / 正在交付
+    int64_t DroppedFrames = 0;
+    int maxFrames = 0;
+
+    ReverseGop() = default;
+    ReverseGop(const ReverseGop&) = delete;
+    ReverseGop& operator=(const ReverseGop&) = delete;
+
+    ~ReverseGop() {
+        for (auto& frame : frames) {
+            av_frame_free(&frame.Frame);
+        }
+    }
+
+    // capacity 为初始帧数，maxCapacity 为增长上限
+    bool Init(int capacity, int maxCapacity) {
+        if (capacity <= 0) capacity = kDefaultReverseCacheFrames;
+        maxFrames = std::max(1, maxCapacity);
+        capacity = std::min(capacity, maxFrames);
+        for (auto& frame : frames) {
+            av_frame_free(&frame.Frame);
+        }
+        frames.assign(capacity, QueuedFrame());
+        for (auto& frame : frames) {
+            frame.Frame = av_frame_alloc();
+            if (!frame.Frame) return false;
+        }
+        Reset();
+        return true;
+    }
+
+    int Size() const {
+        return count;
+    }
+
+    int Capacity() const {
+        return (int)frames.size();
+    }
+
+    // 下一帧的写入位置，已满时先增长，到达上限后覆盖最早的帧
+    QueuedFrame* PeekWritable() {
+        int capacity = (int)frames.size();
+        if (count == capacity && Grow()) {
+            capacity = (int)frames.size();
+        }
+        if (count == capacity) {
+            ReleaseEntry(frames[start]);
+            start = (start + 1) % capacity;
+            count--;
+            DroppedFrames++;
+        }
+        return &frames[(start + count) % capacity];
+    }
+
+    void Push(int64_t ptsUS) {
+        if (FirstPtsUS == AV_NOPTS_VALUE || ptsUS < FirstPtsUS) {
+            FirstPtsUS = ptsUS;
+        }
+        count++;
+    }
+
+    // 最新（pts 最大）的帧，空时返回 nullptr
+    QueuedFrame* PeekNewest() {
+        return count > 0 ? &frames[(start + count - 1) % frames.size()] : nullptr;
+    }
+
+    // 把最新的帧交换到帧队列槽位
+    void MoveNewestTo(QueuedFrame* slot) {
+        QueuedFrame& entry = frames[(start + count - 1) % frames.size()];
+        // 槽位原有的转换缓冲留给缓存下次复用
+        bool slotConverted = slot->Converted;
+        std::swap(slot->Frame, entry.Frame);
+        slot->PtsUS = entry.PtsUS;
+        slot->DurationUS = entry.DurationUS;
+        slot->Converted = entry.Converted;
+        slot->OutputBuffer = entry.OutputBuffer;
+        entry.Converted = slotConverted;
+        count--;
+    }
+
+    void Reset() {
+        while (count > 0) {
+            ReleaseEntry(frames[(start + count - 1) % frames.size()]);
+            count--;
+        }
+        start = 0;
+        FirstPtsUS = AV_NOPTS_VALUE;
+        Complete = false;
+    }
+
+private:
+    // 容量翻倍（不超过 maxFrames），先把环形缓冲展开成从 0 开始
+    bool Grow() {
+        int capacity = (int)frames.size();
+        if (capacity >= maxFrames) {
+            return false;
+        }
+        std::rotate(frames.begin(), frames.begin() + start, frames.end());
+        start = 0;
+        int target = std::min(maxFrames, std::max(capacity * 2, 1));
+        while ((int)frames.size() < target) {
+            QueuedFrame entry;
+            entry.Frame = av_frame_alloc();
+            if (!entry.Frame) break;
+            frames.push_back(entry);
+        }
+        return (int)frames.size() > capacity;
+    }
+
+    static void ReleaseEntry(QueuedFrame& entry) {
+        if (!entry.Converted) {
+            av_frame_unref(entry.Frame);
+        }
+    }
+};
@@ -0,0 +1,21 @@
+// Copyright (c) 2025 Anders Xiao. All rights reserved.
+// https://github.com/endink
+
+#pragma once
+#include "videoplayer_c_api.h"
+
+extern "C" {
+	#include <libavutil/frame.h>
+}
+
+struct FFmpegContext;
+
+struct VideoFrame {
+	int Width = 0;
+	int Height = 0;
+	int Rotation = 0;
+	double TimeMills = 0;
+	int OutputBuffer = -1; // RegisterOutputBuffers 注册的缓冲下标，-1 表示内部缓冲
+	AVFrame* AvFrame = nullptr;
+	FFmpegContext* Context = nullptr;
+};
@@ -6,32 +6,116 @@
 #include "ffmepg_context.h"
 #include "video_stream.h"
 #include "format_converter.h"
+#include "packet_queue.h"
+#include "frame_queue.h"
+#include "frame_mailbox.h"
+#include "command_queue.h"
+#include "decode_scheduler.h"
+#include "frame_pacer.h"
+#include "pcm_ring_buffer.h"
+#include "media_clock.h"
+#include "reverse_gop.h"
+#include "probe_cache.h"
+#include "output_buffers.h"
 #include <string>
 #include <memory>
 #include <vector>
+#include <deque>
 #include <thread>
 #include <mutex>
 #include <atomic>
+#include <condition_variable>
+#include <chrono>
 #include <algorithm> // clamp
 
 extern "C" {
 #include <libavformat/avformat.h>
 #include <libavutil/time.h>
 #include <libavutil/avutil.h>
+#include <libavutil/channel_layout.h>
+#include <libswresample/swresample.h>
 }
 
 const size_t kCustomIoBufferSize = 32 * 1024;
 const size_t kInitialPcmBufferSize = 128 * 1024;
+// demux 线程在队列满 / 暂停时检查命令队列的最长间隔
+const int kCommandPollMills = 10;
+// 落后超过该值的帧不再转换 / 呈现
+const int64_t kLateFrameUS = 30000;
+// 落后超过该值时解码器只解关键帧
+const int64_t kFarBehindUS = 500000;
+// 连续丢帧上限，保证严重落后时画面仍然刷新
+const int kMaxConsecutiveDrops = 8;
+// 共享调度器模式下一个时间片最多推进的步数
+const int kSchedulerSliceSteps = 16;
+// PCM 环形缓冲已满时音频解码线程的轮询间隔
+const int kAudioPollMills = 5;
+// 视频时钟与主时钟偏差超过该值时校正
+const int64_t kAvSyncThresholdUS = 40000;
+// 偏差超过该值视为时间轴不连续（循环 / seek 过渡期），不做校正
+const int64_t kAvNoSyncThresholdUS = 10000000;
+// 音频时钟超过该时长未更新（引擎停止拉取）时视为无效
+const int64_t kAudioClockMaxAgeUS = 200000;
+// 播放速率范围
+const double kMinPlaybackRate = 0.1;
+const double kMaxPlaybackRate = 32.0;
+// 达到该速率后只解码关键帧（trick play）
+const double kDefaultTrickPlayRate = 4.0;
+// 离线模式下等待消费者取走邮箱中上一帧的轮询间隔
+const int kOfflinePollMills = 1;
+// 主机驱动模式下请求时间超过已解码位置该值时直接 seek，而不是顺序解码过去
+const int64_t kHostSeekAheadUS = 2000000;
+// 快速打开时在播放中统计解码耗时估算解码速度的帧数（与 GetDecoderFPS 相同）
+const int kDecoderFpsSampleFrames = 10;
+// 拖动进度条时最后一次 seek 之后静止该时长，再从关键帧预览精确解码到目标帧
+const int64_t kScrubSettleUS = 150000;
+// 探测缓存命中、但 demuxer 不能跳过 avformat_find_stream_info 时使用的最小探测量
+const int64_t kCachedProbeSize = 256 * 1024;
+const int64_t kCachedAnalyzeDurationUS = 200000;
+// playlist 预打开下一项时预读的视频包数，切换时不必等待 IO
+const int kPlaylistPrerollPackets = 8;
+// playlist 切换后保留的上一项数量（队列中的帧 / 邮箱中的帧仍可能引用它们的上下文）
+const size_t kPlaylistRetiredItems = 2;
+// playlist 切换时等待音频解码排空的最长时间，引擎不拉取音频时不阻塞视频
+const int64_t kSwitchAudioWaitUS = 1000000;
+// deadline 前最后这段时间不再用条件变量等待（唤醒误差大），改为绝对 deadline 睡眠 + 自旋
+const int64_t kPacingSleepLeadUS = 2000;
+// 共享调度器模式下离 deadline 不超过该值即呈现，不在共享的工作线程上睡眠 / 自旋
+const int64_t kScheduledPresentEarlyUS = 250;
+#if defined(PLATFORM_WINDOWS)
+const int64_t kDefaultPacingSpinUS = 1000;
+#else
+const int64_t kDefaultPacingSpinUS = 200;
+#endif
+
+enum class CatchUpLevel {
+	None = 0,
+	NonRef,  // AVDISCARD_NONREF
+	NonKey,  // AVDISCARD_NONKEY
+};
 
-struct VideoFrame {
-	int Width = 0;
-	int Height = 0;
-	int Rotation = 0;
-	double TimeMills = 0;
-	AVFrame* AvFrame = nullptr;
-	FFmpegContext* Context = nullptr;
+// playlist 中一项打开后的全部资源，后台线程预打开，demux 线程在当前项结尾处换入
+struct PlaylistMedia {
+	int Index = -1;
+	std::unique_ptr<IVideoStream> IO;   // 先于 Context 声明，Context 先析构
+	std::unique_ptr<FFmpegContext> Context;
+	std::unique_ptr<VideoInfo> Info;
+	std::unique_ptr<FormatConverter> Converter;
+	std::unique_ptr<ProbeCache> Probe;
+	ProbeCacheEntry ProbeInfo;
+	std::vector<AVPacket*> Preroll;     // 预读的包（按读取顺序），换入时先于新读的包入队
+
+	~PlaylistMedia() {
+		for (auto& packet : Preroll) {
+			av_packet_free(&packet);
+		}
+	}
 };
 
+struct VideoPlayer;
+// 当前线程正在执行时间片的播放器（共享调度器工作线程）
+static thread_local VideoPlayer* tlsSlicePlayer = nullptr;
+
 struct VideoPlayer
 {
 	// public API visible fields
@@ -43,33 +127,508 @@ struct VideoPlayer
 	int64_t FirstFrameTime = 0;
 	std::unique_ptr<FormatConverter> FormatConverter;
 	std::vector<uint8_t> FrameData;
+	// caller staging memory registered by RegisterOutputBuffers, only replaced while closed
+	std::unique_ptr<OutputBufferSet> OutputBuffers;
 
 	// thread-safe state
 	std::atomic<int64_t> CurrentTimeMills{ 0 };
 
-	// single mutex protecting shared mutable state (worker, context lifecycle, IO, etc.)
+	// single mutex protecting shared mutable state (context lifecycle, IO, etc.)
 	std::mutex Mutex;
 
-	std::atomic<bool> IsRunning{ false };
-	std::thread Worker;
+	// worker threads live from Open to Close, control calls only post commands
+	std::atomic<bool> IsAlive{ false };
+	std::atomic<bool> IsRunning{ false }; // false when paused
+	std::atomic<double> PlaybackRate{ 1.0 };
+	// keyframe-only fast forward, switched by the demux thread when the rate crosses TrickPlayRate
+	std::atomic<bool> TrickPlay{ false };
+	double TrickPlayRate = kDefaultTrickPlayRate;
+	// reverse playback, switched by the demux thread; every switch flushes the packet queue
+	std::atomic<bool> Reverse{ false };
+	// first GOP after entering reverse / seeking in reverse: frames at or after it are not shown
+	std::atomic<int64_t> ReverseStartUS{ AV_NOPTS_VALUE };
+	// accurate seek target (pts us) for the packet serial started by the last seek, AV_NOPTS_VALUE for keyframe seeks
+	std::atomic<int64_t> AccurateSeekUS{ AV_NOPTS_VALUE };
+
+	// reverse demux state, owned by the demux thread: reads GOPs backwards from EndUS
+	struct ReverseDemuxState {
+		int64_t EndUS = AV_NOPTS_VALUE;      // 下一个要读取的 GOP 的结束 pts（不含）
+		int64_t StartUS = AV_NOPTS_VALUE;    // 当前 GOP 关键帧的 pts
+		bool Reading = false;
+	} ReverseDemux;
+
+	// scrub state, owned by the demux thread: seeks show the keyframe preview, the last target is refined once the slider rests
+	struct ScrubState {
+		bool Active = false;
+		bool Pending = false;                // 最后一次预览之后还没有精确 seek
+		int64_t TargetUS = 0;
+		int64_t LastSeekUS = 0;              // 最后一次预览 seek 的单调时钟时间
+	} Scrub;
+	std::atomic<bool> Scrubbing{ false };   // presenter 在拖动期间只显示预览帧
+	std::thread Worker;       // decode thread
+	std::thread DemuxWorker;  // demux thread, feeds VideoPackets and executes Commands
+	std::thread PresentWorker; // present thread, consumes VideoFrames
+	std::thread AudioWorker;   // audio decode thread, fills AudioPcm
+	std::thread IndexWorker;   // key frame scan, only when the container has no index
+	std::atomic<bool> IndexCancel{ false };
+	// OpenAsync: background open thread, cancelled by Close (interrupts blocking IO)
+	std::mutex OpenMutex;
+	std::thread OpenWorker;
+	std::atomic<bool> Opening{ false };
+	std::atomic<bool> OpenCancel{ false };
+
+	// playlist state, guarded by PlaylistMutex; Items / Loop are fixed between Open and Close
+	struct PlaylistState {
+		std::vector<std::string> Items;
+		bool Loop = false;
+		std::string ProbeCacheDirectory;     // Options 中的字符串由调用者持有，后续项打开时使用拷贝
+		std::string FormatHint;
+		int Current = -1;                    // demux 正在读取的项
+		FFmpegContext* CurrentContext = nullptr;
+		int Preparing = -1;                  // 等待后台线程打开的项，-1 表示没有
+		int Failures = 0;                    // 连续打开失败的项数，全部失败时不再尝试
+		std::unique_ptr<PlaylistMedia> Next;
+		std::deque<std::unique_ptr<PlaylistMedia>> Retired;
+	} Playlist;
+	std::mutex PlaylistMutex;
+	std::condition_variable PlaylistCond;
+	std::thread PlaylistWorker; // opens the next playlist item while the current one plays
+	std::atomic<bool> PlaylistFinished{ false }; // 不循环的 playlist 最后一项已读完，按离线模式结束
+
+	/*
+	  playlist 切换握手：demux 读到结尾后投递 EOF 标记并置 SwitchPending，解码 / 音频线程排空解码器后停下
+	  （VideoDrained / AudioDrained），demux 在 Mutex 下换入下一项并递增 SwitchGeneration，两个线程据此切换解码器。
+	  SwitchSerial 为发起切换时的包序列号，seek 会取消切换，之前的 EOF 标记不会被当作切换。
+	*/
+	std::atomic<bool> SwitchPending{ false };
+	std::atomic<int> SwitchGeneration{ 0 };
+	std::atomic<int> SwitchSerial{ 0 };
+	std::atomic<int> SwitchAudioSerial{ 0 };
+	std::atomic<bool> VideoDrained{ false };
+	std::atomic<bool> AudioDrained{ false };
+	int64_t SwitchRequestUS = 0; // demux thread only
+	// sidecar probe cache of the opened file, written on a miss and again when the key frame scan completes
+	std::unique_ptr<ProbeCache> Probe;
+	ProbeCacheEntry ProbeInfo;
 	void* UserData = nullptr;
 
+	// control API -> demux thread
+	CommandQueue Commands;
+
+	// wakes the present thread when play state changes
+	std::mutex StateMutex;
+	std::condition_variable StateCond;
+	uint64_t StateVersion = 0;
+
+	// demux -> decode
+	PacketQueue VideoPackets;
+	// decode -> present
+	FrameQueue VideoFrames;
+	int DecodeSerial = 0;
+	// present -> engine tick (pull mode)
+	FrameMailbox LatestFrame;
+
+	// demux -> audio decode -> engine audio thread (ReadAudioSamples)
+	PacketQueue AudioPackets;
+	PcmRingBuffer AudioPcm;
+	SwrContext* Resampler = nullptr;
+	AVSampleFormat AudioOutFormat = AV_SAMPLE_FMT_FLT;
+	int AudioOutRate = 0;
+	int AudioOutChannels = 0;
+	int AudioBytesPerFrame = 0; // 一个交错采样帧的字节数，0 表示没有音频输出
+	// 打开后引擎调用过 ReadAudioSamples：之后音频队列满时 demux 等待，而不是丢弃音频包
+	std::atomic<bool> AudioPulled{ false };
+	// pts (us) of the end of the PCM written to AudioPcm, AV_NOPTS_VALUE after a seek
+	std::atomic<int64_t> AudioWrittenPtsUS{ AV_NOPTS_VALUE };
+	// playlist: AudioPcm write position where the audio thread switched items, the PCM before it belongs to the previous item
+	std::atomic<uint64_t> AudioSwitchPos{ 0 };
+	std::atomic<FFmpegContext*> AudioSwitchContext{ nullptr };
+
+	// A/V sync
+	VideoMasterClock MasterClock = VIDEO_MASTER_CLOCK_VIDEO;
+	MediaClock AudioClock;    // written by ReadAudioSamples
+	MediaClock ExternalClock; // written by SetExternalClock
+
+	// present clock published by the present thread so the decode thread can detect late frames,
+	// fields are updated independently, readers only use them as a heuristic
+	std::atomic<int> ClockSerial{ -1 };
+	std::atomic<int64_t> ClockPtsUS{ 0 };
+	std::atomic<int64_t> ClockWallUS{ 0 };
+	std::atomic<double> ClockRate{ 1.0 };
+
+	// statistics
+	std::atomic<int64_t> PresentedFrames{ 0 };
+	std::atomic<int64_t> DecoderDroppedFrames{ 0 };
+	std::atomic<int64_t> PresenterDroppedFrames{ 0 };
+	std::atomic<int64_t> DecoderSkippedFrames{ 0 };
+	std::atomic<int> CurrentCatchUpLevel{ 0 };
+	PacingStats Pacing;
+	std::atomic<int64_t> AvSyncDriftUS{ 0 };
+	std::atomic<int64_t> SyncCorrections{ 0 };
+	std::atomic<int64_t> RepeatedFrames{ 0 };
+	std::atomic<int64_t> SeekDiscardedFrames{ 0 };
+	std::atomic<int64_t> CoalescedSeeks{ 0 };
+	std::atomic<int64_t> Loops{ 0 };
+	std::atomic<int> PlaylistIndex{ -1 }; // 正在呈现的 playlist 项
+
 	// helper fields
-	int64_t StartWallClockUS = 0; // used for pts->wallclock sync
+	// pts of the stream start, CurrentTimeMills is relative to it; rewritten by the demux thread on a playlist switch
+	std::atomic<int64_t> StreamStartUS{ 0 };
+	int64_t PacingSpinUS = kDefaultPacingSpinUS;
+
+	// offline mode
+	bool DemuxEnded = false;                  // demux thread only
+	std::atomic<bool> EndOfStream{ false };   // last frame delivered
+
+	// host-driven mode: last requested time (pts us), frames ending before it are never converted
+	std::atomic<int64_t> HostTargetUS{ AV_NOPTS_VALUE };
+
+	// host-driven present state, owned by the RequestFrameAt caller
+	struct HostState {
+		int64_t PtsUS = AV_NOPTS_VALUE; // 当前已呈现帧的时间范围 [PtsUS, EndUS)
+		int64_t EndUS = AV_NOPTS_VALUE;
+		int Serial = -1;
+		int64_t SeekTargetUS = AV_NOPTS_VALUE; // 已投递但尚未呈现的 seek 目标
+		int SeekSerial = -1;                   // 投递 seek 时的包序列号，等于它的帧来自 seek 之前
+	} Host;
+
+	// how late a frame would be if presented now, 0 when the present clock is not anchored to its serial
+	int64_t FrameLatenessUS(int serial, int64_t pts_us) const
+	{
+		if (Options.HostDriven) {
+			// 主机驱动：相对最近一次请求的媒体时间，与墙钟无关
+			int64_t target_us = HostTargetUS.load();
+			return target_us == AV_NOPTS_VALUE ? 0 : target_us - pts_us;
+		}
+		if (!IsRunning.load() || ClockSerial.load() != serial) return 0;
+		double rate = ClockRate.load();
+		int64_t target_us = ClockWallUS.load() + (int64_t)((pts_us - ClockPtsUS.load()) / rate);
+		return MonotonicNowUS() - target_us;
+	}
+
+	// 帧相对其所属媒体开始的时间，playlist 切换后队列中仍可能有上一项的帧
+	int64_t FrameTimeMills(const QueuedFrame* slot) const
+	{
+		int64_t start_us = slot->Context ? slot->Context->GetStartTimeUS() : StreamStartUS.load();
+		return (slot->PtsUS - start_us) / 1000;
+	}
+
+	// master clock time (pts us) at now_us, AV_NOPTS_VALUE when the video clock is master or the master is not running
+	int64_t MasterClockUS(int64_t now_us) const
+	{
+		// 倒放时视频自由运行
+		if (Reverse.load()) return AV_NOPTS_VALUE;
+		switch (MasterClock) {
+		case VIDEO_MASTER_CLOCK_AUDIO:
+			// 音频不参与变速，非 1x 时视频自由运行
+			if (PlaybackRate.load() != 1.0) return AV_NOPTS_VALUE;
+			return AudioClock.Get(now_us, kAudioClockMaxAgeUS);
+		case VIDEO_MASTER_CLOCK_EXTERNAL:
+			return ExternalClock.Get(now_us, INT64_MAX);
+		default:
+			return AV_NOPTS_VALUE;
+		}
+	}
 
+	// decode state, owned by whoever runs DecodeOnce
+	struct DecoderState {
+		AVFrame* Frame = nullptr;
+		bool HasFrame = false; // Frame decoded and waiting for a free FrameQueue slot
+		int64_t PtsUS = 0;
+		int PacketSerial = 0;
+		CatchUpLevel CatchUp = CatchUpLevel::None;
+		CatchUpLevel PendingCatchUp = CatchUpLevel::None;
+		int ConsecutiveDrops = 0;
+		int64_t LastPtsUS = AV_NOPTS_VALUE;
+		bool EndOfStreamPending = false; // 离线模式：解码器已排空，等待空槽位写入流结束标记
+		bool TrickPlay = false;          // 解码器当前是否只解关键帧
+		bool Reverse = false;            // 解码器当前是否在倒放模式
+		int64_t ReverseLimitUS = AV_NOPTS_VALUE; // 倒放时正在解码的 GOP 只保留 pts 小于它的帧
+		int64_t SeekTargetUS = AV_NOPTS_VALUE;   // 精确 seek：在此之前结束的帧解码后直接丢弃，不做转换
+		int64_t DecodeTimeUS = 0;        // 没有探测解码速度时，前几帧在解码调用中的累计耗时
+		int DecodedSamples = 0;
+		bool Parked = false;             // playlist 切换：已排空，等待 demux 换入下一项
+		int Generation = 0;              // 已切换到的 SwitchGeneration
+	} Decoder;
+	// probed at Open, or measured from the first decoded frames when the probe was skipped (FastOpen)
+	std::atomic<double> DecoderFPS{ 0 };
+
+	// reverse playback: one GOP is decoded forward while the previous one is emitted backwards
+	ReverseGop ReverseGops[2];
+	int BuildingGop = 0;
+
+
+	// present state, owned by whoever runs PresentOnce
+	struct PresenterState {
+		int64_t StartTimeUS = 0;  // wallclock 起点
+		int64_t FirstPtsUS = -1;  // 视频起始 pts 对应 wallclock
+		double Rate = 1.0;
+		int Serial = -1;
+		double Direction = 1.0;   // -1 倒放
+		int PacketSerial = -1;
+		int64_t NextDueUS = AV_NOPTS_VALUE; // 上一帧显示结束的 wallclock，无缝循环时下一轮第一帧从这里开始
+		FFmpegContext* Context = nullptr;   // 上一帧所属的媒体，变化表示 playlist 切换到了下一项
+	} Presenter;
+
+	// audio decode state, owned by whoever runs AudioDecodeOnce
+	struct AudioState {
+		AVFrame* Frame = nullptr;
+		std::vector<uint8_t> Pcm; // 已转换但尚未写入 AudioPcm 的数据
+		size_t PcmOffset = 0;
+		size_t PcmSize = 0;
+		int PacketSerial = 0;
+		int64_t PcmEndPtsUS = AV_NOPTS_VALUE; // Pcm 末尾对应的 pts
+		// 正在使用的解码器，playlist 切换时由音频线程自己换成新一项的（重采样器同时重建）
+		AVCodecContext* Codec = nullptr;
+		AVStream* Stream = nullptr;
+		bool Parked = false;
+		int Generation = 0;
+	} Audio;
+
+	AVPacket* DemuxPacket = nullptr;
+
+	bool HasAudioOutput() const { return AudioBytesPerFrame > 0; }
+	// 音频有人拉取且会被输出时，音频队列与视频队列一样对 demux 限流
+	bool AudioBackPressure() const { return HasAudioOutput() && AudioPulled.load() && !TrickPlay.load() && !Reverse.load(); }
+
+	// shared scheduler mode: the pipeline runs as a task instead of dedicated threads
+	bool Scheduled = false;
+	ScheduledTask Task;
+
+	// pipeline steps, block = false never waits (scheduler mode)
+	bool DemuxOnce(bool block);
+	bool DecodeOnce(bool block);
+	bool DemuxReverseOnce(bool block);
+	bool DecodeReverseOnce(bool block);
+	void ResetDecoderForSerial(int serial);
+	void SendVideoPacket(QueuedPacket& item);
+	void StartReverseAt(int64_t pts_us);
+	bool PresentOnce(bool block, int64_t* wait_us);
+	bool PresentAt(int64_t target_us, int timeout_mills);
+	bool AudioDecodeOnce(bool block);
+	void SetCatchUp(CatchUpLevel level);
+	void ApplySkipFrame();
+	bool SeekInternal(int64_t time_us, bool accurate = false);
+	bool SeekByKeyFrameIndex(int64_t pts_us);
+	void QueuePacket(AVPacket* packet);
+	bool DemuxPlaylistEnd(bool block);
+	bool SwitchPlaylistItem(bool block);
+	void AdoptPlaylistVideo();
+	void AdoptPlaylistAudio();
+	int NextPlaylistIndex(int index) const;
+	int PlaylistIndexOf(const FFmpegContext* context);
+	bool AcceptDecodedFrame(int64_t pts_us);
+	int64_t RunScheduledSlice();
+
+	// dedicated threads
 	void LoopPlay();
+	void DemuxLoop();
+	void PresentLoop();
+	void AudioLoop();
+	void PlaylistLoop();
+
+	// caller must hold Mutex, Context must have an opened audio codec
+	bool SetupAudioOutput(const VideoPlayerOptions& options)
+	{
+		AVCodecContext* codecCtx = Context->audioCodecContext;
+		AudioOutFormat = options.AudioSampleFormat == VIDEO_AUDIO_SAMPLE_S16 ? AV_SAMPLE_FMT_S16 : AV_SAMPLE_FMT_FLT;
+		AudioOutRate = options.AudioSampleRate > 0 ? options.AudioSampleRate : codecCtx->sample_rate;
+		AudioOutChannels = options.AudioChannels > 0 ? options.AudioChannels : codecCtx->ch_layout.nb_channels;
+		if (!CreateResampler(codecCtx)) {
+			return false;
+		}
+
+		AudioBytesPerFrame = AudioOutChannels * av_get_bytes_per_sample(AudioOutFormat);
+		size_t capacity = options.AudioBufferMills > 0
+			? (size_t)AudioOutRate * AudioBytesPerFrame * options.AudioBufferMills / 1000
+			: kInitialPcmBufferSize;
+		AudioPcm.Init(std::max(capacity, (size_t)AudioBytesPerFrame));
+		LogInfo("Audio output: %d Hz, %d channels, format: %s, buffer: %d bytes", AudioOutRate, AudioOutChannels, AudioOutFormat == AV_SAMPLE_FMT_S16 ? "s16" : "float", (int)AudioPcm.Capacity());
+		return true;
+	}
+
+	// 从解码器输出格式转换到 AudioOut* 的重采样器，playlist 切换时按新一项的音频参数重建
+	bool CreateResampler(AVCodecContext* codecCtx)
+	{
+		swr_free(&Resampler);
+		AVChannelLayout outLayout;
+		av_channel_layout_default(&outLayout, AudioOutChannels);
+		int ret = swr_alloc_set_opts2(&Resampler,
+			&outLayout, AudioOutFormat, AudioOutRate,
+			&codecCtx->ch_layout, codecCtx->sample_fmt, codecCtx->sample_rate,
+			0, nullptr);
+		av_channel_layout_uninit(&outLayout);
+		if (ret < 0 || swr_init(Resampler) < 0) {
+			LogError("Failed to create audio resampler: %s", getAvError(ret));
+			swr_free(&Resampler);
+			return false;
+		}
+		return true;
+	}
+
+	void ReleaseAudioOutput()
+	{
+		swr_free(&Resampler);
+		AudioBytesPerFrame = 0;
+	}
+
+	// consumer (presenter / host): 释放帧队列队首槽位。共享调度器模式下唤醒任务，
+	// 停在满队列上的解码不必等到下一次轮询；在本播放器自己的时间片内调用时后续步骤会继续解码，不需要唤醒
+	void NextFrame()
+	{
+		VideoFrames.Next();
+		if (Scheduled && tlsSlicePlayer != this) {
+			DecodeScheduler::Shared().Wake(&Task);
+		}
+	}
+
+	bool PostCommand(const PlayerCommand& command)
+	{
+		if (!Commands.Push(command)) {
+			LogWarning("Video player command queue is full, command %d dropped.", (int)command.Type);
+			return false;
+		}
+		VideoPackets.Wakeup();
+		AudioPackets.Wakeup();
+		if (Scheduled) {
+			DecodeScheduler::Shared().Wake(&Task);
+		}
+		return true;
+	}
+
+	// demux thread: returns false when the player is closing
+	bool ProcessCommands();
+
+	// demux thread: 当前模式下不需要的包直接在 demuxer 丢弃（部分容器可以直接不读这些包）。
+	// trick play 只读关键帧；trick play 和倒放时音频不输出，音频流整体丢弃
+	void ApplyStreamDiscard()
+	{
+		bool trick = TrickPlay.load();
+		Context->videoStream->discard = trick ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
+		if (Context->audioStreamIdx >= 0) {
+			bool audio = HasAudioOutput() && !trick && !Reverse.load();
+			Context->audioStream->discard = audio ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+		}
+	}
+
+	void NotifyStateChanged()
+	{
+		std::lock_guard<std::mutex> lock(StateMutex);
+		StateVersion++;
+		StateCond.notify_all();
+	}
+
+	// present thread: sleep until target_us (MonotonicNowUS clock), returns false if interrupted by a state change.
+	// 远离 deadline 时在条件变量上等待（暂停 / seek 可打断），最后 kPacingSleepLeadUS 用绝对 deadline 睡眠 + 自旋
+	bool WaitForPresentTime(int64_t target_us)
+	{
+		int64_t coarse_until_us = target_us - kPacingSleepLeadUS;
+		int64_t now_us = MonotonicNowUS();
+		if (coarse_until_us > now_us) {
+			std::unique_lock<std::mutex> lock(StateMutex);
+			uint64_t version = StateVersion;
+			bool interrupted = StateCond.wait_for(lock, std::chrono::microseconds(coarse_until_us - now_us), [&] {
+				return StateVersion != version || !IsAlive.load();
+			});
+			if (interrupted) return false;
+		}
+		SleepUntilUS(target_us, PacingSpinUS);
+		return true;
+	}
+
+	// caller must hold Mutex
+	bool StartWorkers(bool playing, bool scheduled)
+	{
+		Decoder = DecoderState();
+		Decoder.Frame = av_frame_alloc();
+		Decoder.PacketSerial = VideoPackets.Serial();
+		Presenter = PresenterState();
+		Audio.Frame = av_frame_alloc();
+		Audio.PacketSerial = AudioPackets.Serial();
+		Audio.PcmOffset = Audio.PcmSize = 0;
+		Audio.Codec = Context->audioCodecContext;
+		Audio.Stream = Context->audioStream;
+		Audio.Parked = false;
+		Audio.Generation = 0;
+		SwitchPending = false;
+		SwitchGeneration = 0;
+		AudioSwitchPos = 0;
+		AudioSwitchContext = nullptr;
+		DemuxPacket = av_packet_alloc();
+		if (!Decoder.Frame || !Audio.Frame || !DemuxPacket) {
+			FreePipelineState();
+			return false;
+		}
+
+		VideoPackets.Start();
+		VideoFrames.Start();
+		AudioPackets.Start();
+		IsRunning = playing;
+		IsAlive = true;
+		Scheduled = scheduled;
+		if (scheduled) {
+			Task.Run = [this]() { return RunScheduledSlice(); };
+			DecodeScheduler::Shared().Add(&Task);
+		}
+		else {
+			DemuxWorker = std::thread(&VideoPlayer::DemuxLoop, this);
+			Worker = std::thread(&VideoPlayer::LoopPlay, this);
+			if (!Options.HostDriven) {
+				PresentWorker = std::thread(&VideoPlayer::PresentLoop, this);
+			}
+			if (HasAudioOutput()) {
+				AudioWorker = std::thread(&VideoPlayer::AudioLoop, this);
+			}
+		}
+		return true;
+	}
+
+	// workers must be stopped
+	void FreePipelineState()
+	{
+		av_frame_free(&Decoder.Frame);
+		Decoder.HasFrame = false;
+		av_frame_free(&Audio.Frame);
+		Audio.PcmOffset = Audio.PcmSize = 0;
+		av_packet_free(&DemuxPacket);
+	}
+
+	// wake up all workers and let them exit
+	void StopWorkers()
+	{
+		IsAlive = false;
+		IndexCancel = true;
+		IsRunning = false;
+		VideoPackets.Abort();
+		VideoFrames.Abort();
+		AudioPackets.Abort();
+		NotifyStateChanged();
+		{
+			std::lock_guard<std::mutex> lock(PlaylistMutex);
+			PlaylistCond.notify_all();
+		}
+	}
 
-	// helper to atomically stop thread and extract worker for joining (no join inside lock)
-	std::thread StopAndExtractWorker()
+	// helper to extract workers for joining (no join inside lock)
+	std::vector<std::thread> ExtractWorkers()
 	{
-		std::thread tmp;
-		// acquire lock to safely change state and move thread object out
+		std::vector<std::thread> workers;
 		std::lock_guard<std::mutex> lock(Mutex);
-		bool wasRunning = IsRunning.exchange(false);
-		if (wasRunning && Worker.joinable()) {
-			tmp = std::move(Worker);
+		if (DemuxWorker.joinable()) workers.push_back(std::move(DemuxWorker));
+		if (Worker.joinable()) workers.push_back(std::move(Worker));
+		if (PresentWorker.joinable()) workers.push_back(std::move(PresentWorker));
+		if (AudioWorker.joinable()) workers.push_back(std::move(AudioWorker));
+		if (IndexWorker.joinable()) workers.push_back(std::move(IndexWorker));
+		if (PlaylistWorker.joinable()) workers.push_back(std::move(PlaylistWorker));
+		return workers;
+	}
+
+	static void JoinWorkers(std::vector<std::thread>& workers)
+	{
+		for (auto& t : workers) {
+			if (t.joinable()) t.join();
 		}
-		return tmp;
+		workers.clear();
 	}
 };
 
@@ -123,314 +682,1740 @@ VP_API void GetFrameData(const VideoFrame* frame, uint8_t* dist_data) {
 		CopyRgbaDataRotated(frame->AvFrame, dist_data, frame->Width, frame->Height, frame->Rotation);
 	}
 }
+
+VP_API const uint8_t* GetFramePixels(const VideoFrame* frame, int32_t* out_pitch) {
+	if (!frame || !frame->AvFrame || !frame->AvFrame->data[0]) {
+		return nullptr;
+	}
+	if (out_pitch) {
+		*out_pitch = frame->AvFrame->linesize[0];
+	}
+	return frame->AvFrame->data[0];
+}
+
+VP_API int32_t GetFrameOutputBuffer(const VideoFrame* frame) {
+	return frame ? frame->OutputBuffer : -1;
+}
 /* -----------------------
    IO callbacks (unchanged)
    ----------------------- */
-int ReadCallback(void* opaque, uint8_t* data, int len) {
-	if (opaque == nullptr || data == nullptr || len <= 0) return -1;
+// avformat_open_input / avformat_find_stream_info 在循环中检查，取消打开时尽快返回
+int InterruptCallback(void* opaque) {
 	VideoPlayer* player = static_cast<VideoPlayer*>(opaque);
-	if (player->IO) {
-		return player->IO->Read(data, len);
-	}
-	return -1;
+	return (player && player->OpenCancel.load()) ? 1 : 0;
 }
 
-int64_t SeekCallback(void* opaque, int64_t offset, int whence) {
+// avio 直接读媒体自己的流：打开时还没有发布到 player->IO，playlist 后续项换入后才指向它；关闭播放器时由 InterruptCallback 取消
+static int MediaReadCallback(void* opaque, uint8_t* data, int len) {
+	if (opaque == nullptr || data == nullptr || len <= 0) return -1;
+	int n = static_cast<IVideoStream*>(opaque)->Read(data, len);
+	return n == 0 ? AVERROR_EOF : n;
+}
+
+static int64_t MediaSeekCallback(void* opaque, int64_t offset, int whence) {
 	if (opaque == nullptr) return -1;
-	VideoPlayer* player = static_cast<VideoPlayer*>(opaque);
-	if (player->IO) {
-		return player->IO->Seek(offset, whence);
-	}
-	return -1;
+	return static_cast<IVideoStream*>(opaque)->Seek(offset, whence);
 }
 
 /* -----------------------
    Decode / Process frame
    ----------------------- */
-VideoPlayerErrorCode processDecodedVideoFrame(VideoPlayer* player, AVFrame* frame) {
-	VideoPlayerErrorCode ret = VideoPlayerErrorCode::kErrorCode_Success;
-	double pts_sec = 0.0;
-	if (!player || !frame) return VideoPlayerErrorCode::kErrorCode_Invalid_Param;
+
+// decode thread: 不旋转的帧从注册的输出缓冲中借一块作为转换目标，sws_scale 直接写入调用者的内存
+static int AcquireOutputBuffer(VideoPlayer* player, QueuedFrame* slot)
+{
+	OutputBufferSet* buffers = player->OutputBuffers.get();
+	const auto* converter = player->FormatConverter.get();
+	if (!buffers || player->Context->videoRotation != 0 ||
+		(converter->distPixelFormat != AV_PIX_FMT_RGBA && converter->distPixelFormat != AV_PIX_FMT_BGRA) ||
+		!buffers->Fits(converter->distWidth, converter->distHeight)) {
+		return -1;
+	}
+	av_frame_unref(slot->Frame);
+	return buffers->Acquire(slot->Frame, converter->distWidth, converter->distHeight, converter->distPixelFormat);
+}
+
+// decode thread: 格式转换后写入帧队列槽位；useOutputBuffers 为 false 时（倒放 GOP 缓存）只使用内部缓冲
+VideoPlayerErrorCode convertDecodedVideoFrame(VideoPlayer* player, AVFrame* frame, QueuedFrame* slot, bool useOutputBuffers) {
+	if (!player || !frame || !slot) return VideoPlayerErrorCode::kErrorCode_Invalid_Param;
 
 	if (player->Context == nullptr || player->Context->videoStreamIdx < 0) {
 		return VideoPlayerErrorCode::kErrorCode_Invalid_Param;
 	}
 
-	// get pts in stream timebase
-	int64_t pts = ff_get_best_effort_timestamp(frame);
-	if (pts == AV_NOPTS_VALUE) pts = 0;
+	if ((frame->format != AV_PIX_FMT_RGBA && frame->format != AV_PIX_FMT_BGRA) || player->Options.FrameScale != 1.0f) {
+		slot->OutputBuffer = useOutputBuffers ? AcquireOutputBuffer(player, slot) : -1;
+		if (!player->FormatConverter->ConvertTo(frame, slot->Frame)) {
+			if (slot->OutputBuffer >= 0) {
+				av_frame_unref(slot->Frame);
+				slot->OutputBuffer = -1;
+			}
+			return VideoPlayerErrorCode::kErrorCode_FFmpeg_Error;
+		}
+		slot->Converted = true;
+	}
+	else {
+		// 无需转换，直接持有解码帧的引用
+		av_frame_unref(slot->Frame);
+		av_frame_move_ref(slot->Frame, frame);
+		slot->Converted = false;
+		slot->OutputBuffer = -1;
+	}
+	return VideoPlayerErrorCode::kErrorCode_Success;
+}
+
+// present thread: 把已转换的帧交给用户回调
+VideoPlayerErrorCode processDecodedVideoFrame(VideoPlayer* player, const QueuedFrame* slot) {
+	if (!player || !slot) return VideoPlayerErrorCode::kErrorCode_Invalid_Param;
 
-	pts_sec = pts * av_q2d(player->Context->avformatContext->streams[player->Context->videoStreamIdx]->time_base);
+	if (player->Context == nullptr || player->Context->videoStreamIdx < 0) {
+		return VideoPlayerErrorCode::kErrorCode_Invalid_Param;
+	}
 
-	AVFrame* avFrame = frame;
-	if ((avFrame->format != AV_PIX_FMT_RGBA && avFrame->format != AV_PIX_FMT_BGRA) || player->Options.FrameScale != 1.0f) {
-		player->FormatConverter->Convert(frame);
-		avFrame = player->FormatConverter->convertedFrame;
+	FFmpegContext* ctx = slot->Context ? slot->Context : player->Context.get();
+	if (ctx != player->Presenter.Context) {
+		player->Presenter.Context = ctx;
+		if (!player->Playlist.Items.empty()) {
+			player->PlaylistIndex = player->PlaylistIndexOf(ctx);
+		}
 	}
 
-	int rotate = 0 - player->Context->videoRotation;
+	int rotate = 0 - ctx->videoRotation;
 	rotate = rotate >= 0 ? rotate : 360 + rotate;
 
 	VideoFrame vf;
-	vf.AvFrame = avFrame;
-	vf.Height = player->Context->actualFrameHeight;
-	vf.Width = player->Context->actualFrameWidth;
+	vf.AvFrame = slot->Frame;
+	vf.Height = ctx->actualFrameHeight;
+	vf.Width = ctx->actualFrameWidth;
 	vf.Rotation = rotate;
-	vf.Context = player->Context.get();
-	vf.TimeMills = (int64_t)(pts_sec * 1000);
+	vf.Context = ctx;
+	vf.TimeMills = (int64_t)(slot->PtsUS / 1000);
+	vf.OutputBuffer = slot->OutputBuffer;
+	if (vf.OutputBuffer >= 0 && player->OutputBuffers) {
+		// 调用者 ReleaseOutputBuffer 之前不再写入这块缓冲
+		player->OutputBuffers->Hold(vf.OutputBuffer);
+	}
 
 	if (player->Options.FrameCallback) {
-		// callback executed on decode thread - user must ensure callback is safe
+		// callback executed on present thread - user must ensure callback is safe
 		player->Options.FrameCallback(&vf, player->UserData);
 	}
 
-	return ret;
+	if (player->Options.LatestFrameMailbox) {
+		player->LatestFrame.Publish(vf);
+	}
+
+	return VideoPlayerErrorCode::kErrorCode_Success;
 }
 
 /* -----------------------
-   LoopPlay - decode thread
+   Commands - executed on demux thread
    ----------------------- */
-void VideoPlayer::LoopPlay()
+bool VideoPlayer::ProcessCommands()
 {
-	// 早期检查 Context
+	PlayerCommand command;
+	while (Commands.Pop(command))
 	{
-		std::lock_guard<std::mutex> lock(Mutex);
-		if (!Context || !Context->avformatContext || Context->videoStreamIdx < 0 || !Context->videoCodecContext) {
-			LogError("Invalid video player context in LoopPlay");
+		switch (command.Type)
+		{
+		case PlayerCommandType::Play:
+			IsRunning = true;
+			break;
+		case PlayerCommandType::Pause:
 			IsRunning = false;
-			return;
+			break;
+		case PlayerCommandType::Rate:
+		{
+			PlaybackRate = command.Rate;
+			bool trick = command.Rate >= TrickPlayRate && !Options.Offline && !Options.HostDriven;
+			if (trick != TrickPlay.load()) {
+				LogInfo("Trick play %s at %.2fx", trick ? "enabled" : "disabled", command.Rate);
+				TrickPlay = trick;
+				ApplyStreamDiscard();
+				// 从当前画面重新开始：进入时丢掉已缓冲的非关键帧包，退出时从关键帧重建参考帧
+				SeekInternal(CurrentTimeMills.load() * 1000, !trick);
+			}
+			break;
+		}
+		case PlayerCommandType::Reverse:
+		{
+			bool reverse = command.Value != 0 && !Options.Offline && !Options.HostDriven;
+			if (reverse != Reverse.load()) {
+				LogInfo("Reverse playback %s", reverse ? "enabled" : "disabled");
+				int64_t position_us = CurrentTimeMills.load() * 1000;
+				Reverse = reverse;
+				ApplyStreamDiscard();
+				SeekInternal(position_us, true);
+			}
+			break;
+		}
+		case PlayerCommandType::Seek:
+		{
+			// 只执行连续 seek 中的最后一个，拖动进度条时积压的目标直接跳过
+			PlayerCommand next;
+			if (Commands.Peek(next) && next.Type == PlayerCommandType::Seek) {
+				CoalescedSeeks++;
+				break;
+			}
+			if (Scrub.Active) {
+				// 预览：只 seek 到关键帧，解码出的第一帧立即呈现；精确位置等静止后再解码
+				Scrub.TargetUS = command.Value;
+				Scrub.Pending = true;
+				Scrub.LastSeekUS = MonotonicNowUS();
+				SeekInternal(command.Value, false);
+			}
+			else {
+				Scrub.Pending = false;
+				SeekInternal(command.Value, command.Accurate);
+			}
+			break;
+		}
+		case PlayerCommandType::Scrub:
+			Scrub.Active = command.Value != 0;
+			Scrubbing = Scrub.Active;
+			if (!Scrub.Active && Scrub.Pending) {
+				// 松开进度条：立即精确定位到最后的目标
+				Scrub.Pending = false;
+				SeekInternal(Scrub.TargetUS, true);
+			}
+			break;
+		case PlayerCommandType::Close:
+			StopWorkers();
+			return false;
+		}
+		NotifyStateChanged();
+	}
+
+	if (Scrub.Pending && MonotonicNowUS() - Scrub.LastSeekUS >= kScrubSettleUS) {
+		// 进度条静止：在预览的关键帧之后精确解码到目标帧
+		Scrub.Pending = false;
+		SeekInternal(Scrub.TargetUS, true);
+		NotifyStateChanged();
+	}
+	return IsAlive.load();
+}
+
+// demux thread: seek by global timestamp (AV_TIME_BASE units), accurate seeks decode forward to the exact frame
+bool VideoPlayer::SeekInternal(int64_t time_us, bool accurate)
+{
+	// 在 Flush 之前设置，解码线程在新序列的第一个包上读取
+	AccurateSeekUS = accurate ? time_us + StreamStartUS : AV_NOPTS_VALUE;
+
+	if (Reverse.load()) {
+		// 倒放：从目标位置所在的 GOP 开始向前读取，实际的 seek 在 DemuxReverseOnce 中进行
+		StartReverseAt(time_us + StreamStartUS);
+	}
+	else {
+		// av_seek_frame 的时间戳同样是流时间（含 start_time），不是相对流开始的时间
+		int64_t target_us = time_us + StreamStartUS;
+		int ret = SeekByKeyFrameIndex(target_us) ? 0 : av_seek_frame(Context->avformatContext, -1, target_us, AVSEEK_FLAG_BACKWARD);
+		if (ret < 0) {
+			LogError("Seek failed: %s", getAvError(ret));
+			return false;
 		}
 	}
+	// drop packets read before the seek; the serial change tells the decode thread to
+	// flush the codec and the present thread to drop frames decoded before the seek
+	VideoPackets.Flush();
+	AudioPackets.Flush();
+	AudioPcm.DiscardPending();
+	AudioWrittenPtsUS = AV_NOPTS_VALUE;
+	DemuxEnded = false;
+	EndOfStream = false;
+	// 取消还没有完成的 playlist 切换，seek 仍在当前项中进行
+	SwitchPending = false;
+	PlaylistFinished = false;
+	CurrentTimeMills.store(time_us / 1000);
+	return true;
+}
 
+// demux thread: 容器没有索引时 demuxer 只能二分读包或线性查找，直接跳到扫描得到的关键帧字节位置
+bool VideoPlayer::SeekByKeyFrameIndex(int64_t pts_us)
+{
 	AVFormatContext* fmt = Context->avformatContext;
-	AVStream* stream = fmt->streams[Context->videoStreamIdx];
-	AVCodecContext* codecCtx = Context->videoCodecContext;
-	int videoIndex = Context->videoStreamIdx;
+	const KeyFrameIndex& index = Context->keyFrames;
+	if (index.Source() != KeyFrameIndexSource::Scan || (fmt->iformat && (fmt->iformat->flags & AVFMT_NO_BYTE_SEEK))) {
+		return false;
+	}
 
-	int64_t start_time_us = av_gettime(); // wallclock 起点
-	int64_t first_pts_us = -1;            // 视频起始 pts 对应 wallclock
-	int64_t last_pts_us = 0;
+	// 扫描尚未到达目标：已扫描的最后一个关键帧可能远在目标之前，交给 av_seek_frame
+	KeyFrameEntry key;
+	if (!index.Covers(pts_us) || !index.Find(pts_us, key) || key.Pos < 0) {
+		return false;
+	}
+	return av_seek_frame(fmt, -1, key.Pos, AVSEEK_FLAG_BYTE) >= 0;
+}
 
-	AVPacket* packet = av_packet_alloc();
-	AVFrame* frame = av_frame_alloc();
+void VideoPlayer::StartReverseAt(int64_t pts_us)
+{
+	// 包含目标时间所在的帧
+	int64_t end_us = pts_us + 1;
+	ReverseDemux.EndUS = end_us;
+	ReverseDemux.StartUS = AV_NOPTS_VALUE;
+	ReverseDemux.Reading = false;
+	ReverseStartUS = end_us;
+}
 
-	while (IsRunning.load())
-	{
-		int ret = av_read_frame(fmt, packet);
+/* -----------------------
+   Demux step
+   ----------------------- */
+bool VideoPlayer::DemuxOnce(bool block)
+{
+	if (!ProcessCommands()) {
+		return false;
+	}
 
-		if (ret == AVERROR_EOF) {
-			// 循环播放
-			av_seek_frame(fmt, videoIndex, 0, AVSEEK_FLAG_BACKWARD);
-			avcodec_flush_buffers(codecCtx);
-			first_pts_us = -1;
-			continue;
-		}
+	if (SwitchPending.load()) {
+		return SwitchPlaylistItem(block);
+	}
 
-		if (ret < 0) {
-			// 出错，短暂 sleep 避免 busy loop
-			av_usleep(1000 * 5);
-			continue;
+	// 队列已满（字节或时长达到上限）时等待，IO 延迟由已缓冲的包吸收；新命令会提前唤醒
+	// 暂停时音频 PCM 缓冲写满后音频队列也会满，此时同样等待，恢复播放时不会因丢包出现断音
+	bool audio_limited = AudioBackPressure();
+	if (block) {
+		if (!VideoPackets.WaitForSpace(kCommandPollMills)) {
+			return false;
 		}
-
-		if (packet->stream_index != videoIndex) {
-			av_packet_unref(packet);
-			continue;
+		if (audio_limited && !AudioPackets.WaitForSpace(kCommandPollMills)) {
+			return false;
 		}
+	}
+	else if (VideoPackets.IsFull() || (audio_limited && AudioPackets.IsFull())) {
+		return false;
+	}
 
-		// 解码视频包
-		if (avcodec_send_packet(codecCtx, packet) < 0) {
-			av_packet_unref(packet);
-			continue;
-		}
+	if (Reverse.load()) {
+		return DemuxReverseOnce(block);
+	}
 
-		while (avcodec_receive_frame(codecCtx, frame) == 0)
-		{
-			int64_t pts = ff_get_best_effort_timestamp(frame);
-			if (pts == AV_NOPTS_VALUE) pts = 0;
+	if (DemuxEnded) {
+		// 离线模式读到结尾后只等待命令（seek 会重新开始）
+		if (block) av_usleep(kCommandPollMills * 1000);
+		return false;
+	}
 
-			// PTS -> 微秒
-			int64_t pts_us = static_cast<int64_t>(pts * av_q2d(stream->time_base) * 1000000.0);
+	AVFormatContext* fmt = Context->avformatContext;
+	int videoIndex = Context->videoStreamIdx;
+	AVPacket* packet = DemuxPacket;
 
-			if (first_pts_us < 0) {
-				first_pts_us = pts_us;
-				start_time_us = av_gettime(); // 对齐 wallclock
-			}
+	int ret = av_read_frame(fmt, packet);
 
-			// 视频应该显示的时间（wallclock） = pts_us - first_pts_us + start_time_us
-			int64_t target_us = pts_us - first_pts_us + start_time_us;
-			int64_t now_us = av_gettime();
+	if (ret == AVERROR_EOF && !Playlist.Items.empty()) {
+		return DemuxPlaylistEnd(block);
+	}
 
-			int64_t delay_us = target_us - now_us;
+	if (ret == AVERROR_EOF && Options.Offline) {
+		VideoPackets.PutEndOfStream();
+		if (HasAudioOutput()) AudioPackets.PutEndOfStream();
+		DemuxEnded = true;
+		return true;
+	}
 
-			if (delay_us > 0) {
-				// 当前时间比目标时间早，等待
-				av_usleep(delay_us);
-			}
-			else if (delay_us < -30000) {
-				// 当前落后超过 30ms，跳帧赶上
-				// 可选：记录丢帧数量
-			}
+	if (ret == AVERROR_EOF) {
+		// 循环播放：先投递 EOF 标记让解码线程排空解码器，再回到开头
+		VideoPackets.PutEndOfStream();
+		if (HasAudioOutput()) AudioPackets.PutEndOfStream();
+		av_seek_frame(fmt, videoIndex, 0, AVSEEK_FLAG_BACKWARD);
+		return true;
+	}
 
-			// 更新 CurrentTimeMills
-			int64_t t_ms = static_cast<int64_t>((pts_us - first_pts_us) / 1000);
-			CurrentTimeMills.store(t_ms);
+	if (ret < 0) {
+		// 出错，短暂 sleep 避免 busy loop（调度模式下交给调度器延后重试）
+		if (block) av_usleep(1000 * 5);
+		return false;
+	}
+
+	QueuePacket(packet);
+	return true;
+}
 
-			// 处理帧回调
-			processDecodedVideoFrame(this, frame);
+// 按流分发读到的包，调用后 packet 为空包
+void VideoPlayer::QueuePacket(AVPacket* packet)
+{
+	int videoIndex = Context->videoStreamIdx;
+	bool trick = TrickPlay.load();
+	if (trick && packet->stream_index == videoIndex && !(packet->flags & AV_PKT_FLAG_KEY)) {
+		// trick play：关键帧之间的包不进入队列，也不送解码器
+		av_packet_unref(packet);
+		return;
+	}
 
-			last_pts_us = pts_us;
+	if (packet->stream_index == Context->audioStreamIdx && HasAudioOutput()) {
+		// 引擎从未拉取过音频时音频不参与 demux 限流，队列满就丢弃，避免阻塞视频；trick play 时音频无意义
+		// 拉取过音频时 demux 已经等到队列有空间（playlist 预读的包可能略微超出上限），不丢弃
+		if (trick || (!AudioPulled.load() && AudioPackets.IsFull())) {
+			av_packet_unref(packet);
+		}
+		else {
+			AudioPackets.Put(packet);
 		}
+		return;
+	}
 
+	if (packet->stream_index != videoIndex) {
 		av_packet_unref(packet);
+		return;
 	}
 
-	av_frame_free(&frame);
-	av_packet_free(&packet);
+	VideoPackets.Put(packet);
 }
 
-
-
 /* -----------------------
-   C API functions (Open/Close/Pause/Resume/Seek)
+   Playlist
    ----------------------- */
 
-VP_API VideoPlayer* CreateVideoPlayer(void* user_data) {
-	auto* player = new VideoPlayer();
-	player->UserData = user_data;
-	return player;
+// 当前项之后要播放的项，列表结束（不循环）时返回 -1
+int VideoPlayer::NextPlaylistIndex(int index) const
+{
+	int count = (int)Playlist.Items.size();
+	if (index + 1 < count) return index + 1;
+	return Playlist.Loop && count > 0 ? 0 : -1;
 }
 
-VP_API void DestroyVideoPlayer(VideoPlayer* player) {
-	if (player) {
-		Close(player);
-		delete player;
+// 媒体上下文对应的 playlist 项，找不到时返回当前值（需要 PlaylistMutex 之外调用）
+int VideoPlayer::PlaylistIndexOf(const FFmpegContext* context)
+{
+	std::lock_guard<std::mutex> lock(PlaylistMutex);
+	if (context == Playlist.CurrentContext) {
+		return Playlist.Current;
+	}
+	for (auto& media : Playlist.Retired) {
+		if (media->Context.get() == context) {
+			return media->Index;
+		}
 	}
+	return PlaylistIndex.load();
 }
 
-VP_API bool Open(VideoPlayer* player, const char* file, VideoPlayerOptions options)
+// demux thread: 当前项读到结尾。下一项已打开时开始切换，还在打开时等待，列表结束时按离线模式结束
+bool VideoPlayer::DemuxPlaylistEnd(bool block)
 {
-	if (!player || !file) return false;
-
-	// allocate and setup all resources under lock
+	bool ready = false;
+	bool preparing = false;
 	{
-		std::lock_guard<std::mutex> lock(player->Mutex);
+		std::lock_guard<std::mutex> lock(PlaylistMutex);
+		ready = Playlist.Next != nullptr;
+		preparing = Playlist.Preparing >= 0;
+	}
 
-		player->Options = options;
+	if (ready) {
+		// 先置标记再投递 EOF 标记，解码线程排空时据此停下而不是当作循环
+		VideoDrained = false;
+		AudioDrained = false;
+		SwitchSerial = VideoPackets.Serial();
+		SwitchAudioSerial = AudioPackets.Serial();
+		SwitchRequestUS = MonotonicNowUS();
+		SwitchPending = true;
+		VideoPackets.PutEndOfStream();
+		if (HasAudioOutput()) AudioPackets.PutEndOfStream();
+		return true;
+	}
 
-		if (player->Context) {
-			LogWarning("Video player already opened.");
-			return false;
-		}
+	if (preparing) {
+		// 下一项还没有打开完，队列中的帧继续播放
+		if (block) av_usleep(kCommandPollMills * 1000);
+		return false;
+	}
 
+	VideoPackets.PutEndOfStream();
+	if (HasAudioOutput()) AudioPackets.PutEndOfStream();
+	PlaylistFinished = true;
+	DemuxEnded = true;
+	return true;
+}
 
-		// set IO implementation
-		if (strncmp(file, "fd://", 5) == 0) {
-			int fd = std::atoi(file + 5);
-			if (fd < 0) return false;
-			player->IO = std::make_unique<VideoFileDescriptorStream>(fd);
-			LogInfo("Use file descriptor stream: %s", file);
-		}
-		else {
-			std::string file_str(file);
-			player->IO = std::make_unique<VideoFileStream>(file_str);
-			LogInfo("Use file stream: %s", file);
-		}
+/*
+  demux thread: 解码线程（和音频线程）排空后换入下一项。上一项的资源移入 Retired，
+  由 playlist 线程在之后的切换中释放；预读的包先于新读的包入队。
+*/
+bool VideoPlayer::SwitchPlaylistItem(bool block)
+{
+	bool audio_ready = !HasAudioOutput() || AudioDrained.load() || MonotonicNowUS() - SwitchRequestUS > kSwitchAudioWaitUS;
+	if (!VideoDrained.load() || !audio_ready) {
+		if (block) av_usleep(1000);
+		return false;
+	}
 
+	auto retired = std::make_unique<PlaylistMedia>();
+	std::unique_ptr<PlaylistMedia> media;
+	{
+		std::lock_guard<std::mutex> lock(PlaylistMutex);
+		media = std::move(Playlist.Next);
+		retired->Index = Playlist.Current;
+	}
+	if (!media) {
+		SwitchPending = false;
+		return false;
+	}
 
-		auto ctx = std::make_unique<FFmpegContext>();
-		ctx->avformatContext = avformat_alloc_context();
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		// 关键帧扫描属于上一项
+		IndexCancel = true;
+		retired->IO = std::move(IO);
+		retired->Context = std::move(Context);
+		retired->Info = std::move(VideoInfo);
+		retired->Converter = std::move(FormatConverter);
+		retired->Probe = std::move(Probe);
+		IO = std::move(media->IO);
+		Context = std::move(media->Context);
+		VideoInfo = std::move(media->Info);
+		FormatConverter = std::move(media->Converter);
+		Probe = std::move(media->Probe);
+		ProbeInfo = std::move(media->ProbeInfo);
+
+		StreamStartUS = Context->GetStartTimeUS();
+		DecoderFPS = Context->decoderFPS;
+		ApplyStreamDiscard();
+		int64_t frameDurationUS = Context->frameRate > 0 ? (int64_t)(1000000.0 / Context->frameRate) : 0;
+		VideoPackets.Configure(Context->timebase, frameDurationUS, Options.PacketQueueMaxBytes, Options.PacketQueueMaxMills * 1000);
+		if (HasAudioOutput() && Context->audioStream) {
+			AudioPackets.Configure(Context->audioStream->time_base, 0, Options.PacketQueueMaxBytes, Options.PacketQueueMaxMills * 1000);
+		}
 
-		uint8_t* buffer = reinterpret_cast<uint8_t*>(av_malloc(kCustomIoBufferSize));
-		ctx->IoBufferSize = kCustomIoBufferSize;
-		ctx->ioContext = avio_alloc_context(
-			buffer,
-			ctx->IoBufferSize,
-			0,
-			player,
-			ReadCallback,
-			nullptr,
-			SeekCallback);
+		// 解码 / 音频线程看到 SwitchPending 清除时 SwitchGeneration 已经递增
+		SwitchGeneration++;
+		SwitchPending = false;
+	}
 
-		if (ctx->ioContext == nullptr) {
-			LogError("avio_alloc_context failed.");
+	{
+		std::lock_guard<std::mutex> lock(PlaylistMutex);
+		Playlist.Current = media->Index;
+		Playlist.CurrentContext = Context.get();
+		Playlist.Retired.push_back(std::move(retired));
+		Playlist.Preparing = NextPlaylistIndex(media->Index);
+		PlaylistCond.notify_all();
+	}
 
-			if (buffer) {
-				av_free(buffer);
-			}
-			return false;
-		}
+	for (AVPacket* packet : media->Preroll) {
+		QueuePacket(packet);
+	}
+	LogInfo("Playlist switched to item %d: %s", media->Index, Playlist.Items[media->Index].c_str());
 
-		ctx->avformatContext->pb = ctx->ioContext;
-		ctx->avformatContext->flags = AVFMT_FLAG_CUSTOM_IO;
+	if (Options.VideoInfoCallback && VideoInfo) {
+		Options.VideoInfoCallback(VideoInfo.get(), UserData);
+	}
+	return true;
+}
 
-		RTN_FALSE_IF_UNZERO(avformat_open_input(&ctx->avformatContext, NULL, NULL, NULL), "avformat_open_input failed");
-		RTN_FALSE_IF_NEGATIVE(avformat_find_stream_info(ctx->avformatContext, NULL), "avformat_find_stream_info failed.");
-		
-		
-		// open codecs - using your helper functions in FFmpegContext
-		
-		// assume FFmpegContext provides methods to open streams:
-		if (!ctx->LoadVideoProperties(true)) {
-			LogError("LoadVideoProperties failed");
-			return false;
-		}
+/*
+  倒放 demux：seek 到 EndUS 之前的关键帧，顺序读到下一个关键帧（即上一次读取的 GOP 起点）为止，
+  投递 EOF 标记让解码器排空这个 GOP，然后以这个 GOP 的起点作为新的 EndUS 继续向前。
+*/
+bool VideoPlayer::DemuxReverseOnce(bool block)
+{
+	auto& r = ReverseDemux;
+	AVFormatContext* fmt = Context->avformatContext;
+	int videoIndex = Context->videoStreamIdx;
+	AVRational tb = Context->videoStream->time_base;
+	AVPacket* packet = DemuxPacket;
 
-		// open audio only if not muted
-		if (!options.Mute) {
-			// if fails, just continue without audio
-			//(void)ctx->OpenAudioStream();
+	if (!r.Reading) {
+		if (r.EndUS <= StreamStartUS) {
+			// 已倒放到开头：循环到结尾
+			r.EndUS = StreamStartUS + (int64_t)(Context->durationInSeconds * 1000000.0) + 1;
 		}
-		else {
-			ctx->audioStreamIdx = -1;
+		int64_t target = av_rescale_q(r.EndUS - 1, AVRational{ 1, 1000000 }, tb);
+		int ret = SeekByKeyFrameIndex(r.EndUS - 1) ? 0 : av_seek_frame(fmt, videoIndex, target, AVSEEK_FLAG_BACKWARD);
+		if (ret < 0) {
+			LogError("Reverse seek failed: %s", getAvError(ret));
+			if (block) av_usleep(1000 * 5);
+			return false;
+		}
+		r.StartUS = AV_NOPTS_VALUE;
+		r.Reading = true;
+		return true;
+	}
+
+	int ret = av_read_frame(fmt, packet);
+	if (ret < 0 && ret != AVERROR_EOF) {
+		if (block) av_usleep(1000 * 5);
+		return false;
+	}
+
+	bool gop_done = ret == AVERROR_EOF;
+	if (!gop_done) {
+		if (packet->stream_index != videoIndex) {
+			av_packet_unref(packet);
+			return true;
+		}
+
+		int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+		int64_t pts_us = pts != AV_NOPTS_VALUE ? av_rescale_q(pts, tb, AVRational{ 1, 1000000 }) : AV_NOPTS_VALUE;
+		bool key = (packet->flags & AV_PKT_FLAG_KEY) != 0;
+
+		if (r.StartUS == AV_NOPTS_VALUE) {
+			r.StartUS = pts_us != AV_NOPTS_VALUE ? pts_us : StreamStartUS.load();
+		}
+		else if (key && pts_us != AV_NOPTS_VALUE && pts_us >= r.EndUS) {
+			// 下一个 GOP 的关键帧：这个 GOP 读完了
+			gop_done = true;
+		}
+	}
+
+	if (gop_done) {
+		av_packet_unref(packet);
+		VideoPackets.PutEndOfStream();
+		// 没能读到更早的关键帧（seek 落在 EndUS 之后）时从开头继续，避免原地循环
+		r.EndUS = (r.StartUS != AV_NOPTS_VALUE && r.StartUS < r.EndUS) ? r.StartUS : StreamStartUS.load();
+		r.Reading = false;
+		return true;
+	}
+
+	VideoPackets.Put(packet);
+	return true;
+}
+
+/* -----------------------
+   Decode step
+   ----------------------- */
+static AVDiscard ToDiscard(CatchUpLevel level)
+{
+	switch (level) {
+	case CatchUpLevel::NonRef: return AVDISCARD_NONREF;
+	case CatchUpLevel::NonKey: return AVDISCARD_NONKEY;
+	default: return AVDISCARD_DEFAULT;
+	}
+}
+
+// 追帧策略：落后时提高 skip_frame，恢复到正常时降回；从 NONKEY 降级必须等到下一个关键帧，否则参考帧缺失
+void VideoPlayer::SetCatchUp(CatchUpLevel level)
+{
+	auto& d = Decoder;
+	d.PendingCatchUp = level;
+	if (level > d.CatchUp || d.CatchUp != CatchUpLevel::NonKey) {
+		if (level != d.CatchUp) {
+			LogDebug("Decoder catch-up level: %d -> %d", (int)d.CatchUp, (int)level);
+		}
+		d.CatchUp = level;
+		ApplySkipFrame();
+		CurrentCatchUpLevel = (int)level;
+	}
+}
+
+// trick play 时始终只解关键帧，否则由追帧级别决定
+void VideoPlayer::ApplySkipFrame()
+{
+	Context->videoCodecContext->skip_frame = Decoder.TrickPlay ? AVDISCARD_NONKEY : ToDiscard(Decoder.CatchUp);
+}
+
+// 根据落后程度调整追帧级别，返回 false 表示该帧已来不及显示（跳过转换和回调）
+bool VideoPlayer::AcceptDecodedFrame(int64_t pts_us)
+{
+	auto& d = Decoder;
+
+	// 估算 skip_frame 丢掉的帧数
+	int64_t frame_duration_us = Context->frameRate > 0 ? (int64_t)(1000000.0 / Context->frameRate) : 0;
+	if (d.CatchUp != CatchUpLevel::None && d.LastPtsUS != AV_NOPTS_VALUE && frame_duration_us > 0 && pts_us > d.LastPtsUS) {
+		int64_t gap = (pts_us - d.LastPtsUS) / frame_duration_us - 1;
+		if (gap > 0) DecoderSkippedFrames += gap;
+	}
+	d.LastPtsUS = pts_us;
+
+	if (d.SeekTargetUS != AV_NOPTS_VALUE) {
+		// 精确 seek：从关键帧解码到目标帧，中间帧只解码不转换
+		int64_t duration_us = d.Frame->duration > 0
+			? av_rescale_q(d.Frame->duration, Context->videoStream->time_base, AVRational{ 1, 1000000 })
+			: frame_duration_us;
+		if (pts_us + std::max<int64_t>(duration_us, 1) <= d.SeekTargetUS) {
+			SeekDiscardedFrames++;
+			return false;
+		}
+		d.SeekTargetUS = AV_NOPTS_VALUE;
+	}
+
+	if (Options.Offline) {
+		// 离线模式交付每一帧
+		return true;
+	}
+
+	int64_t late_us = FrameLatenessUS(DecodeSerial, pts_us);
+	if (Options.HostDriven) {
+		// 只丢弃在请求时间之前就结束的帧；不调整 skip_frame，非参考帧也可能正是要显示的帧
+		if (late_us > std::max<int64_t>(frame_duration_us, 0)) {
+			DecoderDroppedFrames++;
+			return false;
+		}
+		return true;
+	}
+	if (late_us > kFarBehindUS) {
+		SetCatchUp(CatchUpLevel::NonKey);
+	}
+	else if (late_us > kLateFrameUS) {
+		SetCatchUp(std::max(d.CatchUp, CatchUpLevel::NonRef));
+	}
+	else if (late_us <= 0) {
+		SetCatchUp(CatchUpLevel::None);
+	}
+
+	if (late_us > kLateFrameUS && d.ConsecutiveDrops < kMaxConsecutiveDrops) {
+		d.ConsecutiveDrops++;
+		DecoderDroppedFrames++;
+		return false;
+	}
+	d.ConsecutiveDrops = 0;
+	return true;
+}
+
+// 新序列（seek / 切换倒放）的第一个包：丢弃解码器中 seek 之前的参考帧，重置追帧 / 倒放状态
+void VideoPlayer::ResetDecoderForSerial(int serial)
+{
+	auto& d = Decoder;
+	avcodec_flush_buffers(Context->videoCodecContext);
+	d.PacketSerial = serial;
+	DecodeSerial++;
+	d.LastPtsUS = AV_NOPTS_VALUE;
+	// 解码从关键帧重新开始，可以直接恢复正常解码
+	d.CatchUp = d.PendingCatchUp = CatchUpLevel::None;
+	d.TrickPlay = TrickPlay.load();
+	ApplySkipFrame();
+	CurrentCatchUpLevel = 0;
+
+	// 每次切换倒放都会 flush 包队列，所以在新序列的第一个包上切换模式
+	d.Reverse = Reverse.load();
+	d.ReverseLimitUS = ReverseStartUS.load();
+	d.SeekTargetUS = d.Reverse ? AV_NOPTS_VALUE : AccurateSeekUS.load();
+	ReverseGops[0].Reset();
+	ReverseGops[1].Reset();
+	BuildingGop = 0;
+}
+
+// decode thread: demux 已换入 playlist 下一项，新的解码器从关键帧开始，追帧状态归零
+void VideoPlayer::AdoptPlaylistVideo()
+{
+	auto& d = Decoder;
+	d.Generation = SwitchGeneration.load();
+	d.LastPtsUS = AV_NOPTS_VALUE;
+	d.CatchUp = d.PendingCatchUp = CatchUpLevel::None;
+	d.ConsecutiveDrops = 0;
+	d.DecodeTimeUS = 0;
+	d.DecodedSamples = 0;
+	ApplySkipFrame();
+	CurrentCatchUpLevel = 0;
+}
+
+// 送入解码器并释放包，nullptr 为 EOF 标记
+void VideoPlayer::SendVideoPacket(QueuedPacket& item)
+{
+	auto& d = Decoder;
+	AVCodecContext* codecCtx = Context->videoCodecContext;
+
+	if (!item.Packet) {
+		// EOF 标记：进入排空模式，解码器输出剩余帧后返回 AVERROR_EOF
+		avcodec_send_packet(codecCtx, nullptr);
+		return;
+	}
+
+	// 关键帧边界：允许从 NONKEY 降级
+	if (d.CatchUp == CatchUpLevel::NonKey && d.PendingCatchUp != CatchUpLevel::NonKey && (item.Packet->flags & AV_PKT_FLAG_KEY)) {
+		LogDebug("Decoder catch-up level: %d -> %d", (int)d.CatchUp, (int)d.PendingCatchUp);
+		d.CatchUp = d.PendingCatchUp;
+		ApplySkipFrame();
+		CurrentCatchUpLevel = (int)d.CatchUp;
+	}
+
+	// 解码视频包
+	avcodec_send_packet(codecCtx, item.Packet);
+	VideoPackets.Recycle(item.Packet);
+}
+
+/*
+  倒放解码：正在构建的 GOP 缓存按 pts 递增收集已转换帧，解码器排空（EOF）后该 GOP 完成；
+  另一个缓存同时倒序交付到帧队列。交付和解码交替推进，呈现当前 GOP 时前一个 GOP 已在预取。
+*/
+bool VideoPlayer::DecodeReverseOnce(bool block)
+{
+	auto& d = Decoder;
+	AVCodecContext* codecCtx = Context->videoCodecContext;
+	AVStream* stream = Context->videoStream;
+	ReverseGop& building = ReverseGops[BuildingGop];
+	ReverseGop& emitting = ReverseGops[1 - BuildingGop];
+	bool progress = false;
+
+	// 交付一帧；下一个 GOP 还在解码时不阻塞，帧队列满就继续解码
+	if (emitting.Size() > 0) {
+		QueuedFrame* slot = VideoFrames.PeekWritable(block && building.Complete);
+		if (slot) {
+			emitting.MoveNewestTo(slot);
+			slot->Context = Context.get();
+			slot->Serial = DecodeSerial;
+			slot->PacketSerial = d.PacketSerial;
+			slot->EndOfStream = false;
+			VideoFrames.Push();
+			progress = true;
+		}
+	}
+
+	if (emitting.Size() == 0 && building.Complete) {
+		// 交换：刚解码完的 GOP 开始交付
+		DecoderDroppedFrames += building.DroppedFrames;
+		building.DroppedFrames = 0;
+		emitting.Reset();
+		BuildingGop = 1 - BuildingGop;
+		return true;
+	}
+
+	if (!building.Complete) {
+		int ret = avcodec_receive_frame(codecCtx, d.Frame);
+		if (ret == 0) {
+			int64_t pts = ff_get_best_effort_timestamp(d.Frame);
+			if (pts == AV_NOPTS_VALUE) pts = 0;
+			int64_t pts_us = av_rescale_q(pts, stream->time_base, AVRational{ 1, 1000000 });
+
+			// 只保留还没有显示过的帧（pts 小于上一个 GOP 的起点）
+			if (d.ReverseLimitUS == AV_NOPTS_VALUE || pts_us < d.ReverseLimitUS) {
+				int64_t frame_duration_us = Context->frameRate > 0 ? (int64_t)(1000000.0 / Context->frameRate) : 0;
+				QueuedFrame* entry = building.PeekWritable();
+				entry->PtsUS = pts_us;
+				entry->DurationUS = d.Frame->duration > 0 ? av_rescale_q(d.Frame->duration, stream->time_base, AVRational{ 1, 1000000 }) : frame_duration_us;
+				if (convertDecodedVideoFrame(this, d.Frame, entry, false) == VideoPlayerErrorCode::kErrorCode_Success) {
+					building.Push(pts_us);
+				}
+			}
+			av_frame_unref(d.Frame);
+			return true;
+		}
+
+		if (ret == AVERROR_EOF) {
+			// GOP 解码完成，下一个 GOP 的帧必须早于这个 GOP 的第一帧
+			avcodec_flush_buffers(codecCtx);
+			if (building.FirstPtsUS != AV_NOPTS_VALUE) {
+				d.ReverseLimitUS = building.FirstPtsUS;
+			}
+			if (building.DroppedFrames > 0) {
+				LogWarning("Reverse GOP longer than the cache memory limit (%d frames), %lld earliest frames not shown",
+					building.Capacity(), (long long)building.DroppedFrames);
+			}
+			building.Complete = true;
+			return true;
+		}
+
+		// 还有帧要交付时不阻塞等包
+		QueuedPacket item;
+		int got = VideoPackets.Get(item, block && emitting.Size() == 0);
+		if (got < 0) {
+			return false;
+		}
+		if (got > 0) {
+			if (item.Serial != d.PacketSerial) {
+				ResetDecoderForSerial(item.Serial);
+			}
+			SendVideoPacket(item);
+			return true;
+		}
+	}
+
+	if (!progress && block) {
+		// 缓存已满且帧队列已满：等待呈现线程
+		av_usleep(1000);
+	}
+	return progress;
+}
+
+/*
+  解码器领先于呈现运行：先把已解码的帧放进帧队列，再从解码器取帧，解码器需要输入时才取包。
+  block 为 false 时队列满 / 无包立即返回 false（调度模式），返回 true 表示有进展。
+*/
+bool VideoPlayer::DecodeOnce(bool block)
+{
+	auto& d = Decoder;
+
+	if (d.Parked) {
+		// playlist 切换：解码器已排空，demux 换入下一项之前不访问 Context
+		if (SwitchPending.load() && d.PacketSerial == SwitchSerial.load()) {
+			if (block) av_usleep(1000);
+			return false;
+		}
+		d.Parked = false;
+	}
+	if (d.Generation != SwitchGeneration.load()) {
+		AdoptPlaylistVideo();
+	}
+
+	AVCodecContext* codecCtx = Context->videoCodecContext;
+	AVStream* stream = Context->videoStream;
+
+	if (d.Reverse) {
+		return DecodeReverseOnce(block);
+	}
+
+	if (d.EndOfStreamPending) {
+		QueuedFrame* slot = VideoFrames.PeekWritable(block);
+		if (!slot) {
+			return false;
+		}
+		slot->EndOfStream = true;
+		slot->Context = Context.get();
+		slot->Serial = DecodeSerial;
+		slot->PacketSerial = d.PacketSerial;
+		VideoFrames.Push();
+		d.EndOfStreamPending = false;
+		return true;
+	}
+
+	if (!d.HasFrame) {
+		// 跳过了解码速度探测：用前几帧在解码调用中的耗时估算，不额外解码
+		bool measure = DecoderFPS.load() <= 0;
+		int64_t measure_start = measure ? MonotonicNowUS() : 0;
+		int ret = avcodec_receive_frame(codecCtx, d.Frame);
+		if (measure) {
+			d.DecodeTimeUS += MonotonicNowUS() - measure_start;
+			if (ret == 0 && ++d.DecodedSamples >= kDecoderFpsSampleFrames && d.DecodeTimeUS > 0) {
+				DecoderFPS = d.DecodedSamples * 1000000.0 / d.DecodeTimeUS;
+				LogInfo("Decoder fps measured during playback: %.2f", DecoderFPS.load());
+			}
+		}
+		if (ret == 0) {
+			int64_t pts = ff_get_best_effort_timestamp(d.Frame);
+			if (pts == AV_NOPTS_VALUE) pts = 0;
+
+			// PTS -> 微秒
+			d.PtsUS = static_cast<int64_t>(pts * av_q2d(stream->time_base) * 1000000.0);
+			if (!AcceptDecodedFrame(d.PtsUS)) {
+				av_frame_unref(d.Frame);
+				return true;
+			}
+			d.HasFrame = true;
+		}
+		else if (ret == AVERROR_EOF) {
+			// EOF 标记之后解码器已排空，为下一轮循环 / playlist 下一项重置
+			avcodec_flush_buffers(codecCtx);
+			DecodeSerial++;
+			d.LastPtsUS = AV_NOPTS_VALUE;
+			if (SwitchPending.load() && d.PacketSerial == SwitchSerial.load()) {
+				d.Parked = true;
+				VideoDrained = true;
+				return true;
+			}
+			d.EndOfStreamPending = Options.Offline != 0 || PlaylistFinished.load();
+			return true;
+		}
+		else {
+			QueuedPacket item;
+			if (VideoPackets.Get(item, block) <= 0) {
+				return false;
+			}
+
+			if (item.Serial != d.PacketSerial) {
+				ResetDecoderForSerial(item.Serial);
+			}
+			int64_t send_start = measure ? MonotonicNowUS() : 0;
+			SendVideoPacket(item);
+			if (measure) d.DecodeTimeUS += MonotonicNowUS() - send_start;
+			return true;
+		}
+	}
+
+	QueuedFrame* slot = VideoFrames.PeekWritable(block);
+	if (!slot) {
+		return false;
+	}
+
+	int64_t frame_duration_us = Context->frameRate > 0 ? (int64_t)(1000000.0 / Context->frameRate) : 0;
+	slot->PtsUS = d.PtsUS;
+	slot->DurationUS = d.Frame->duration > 0 ? av_rescale_q(d.Frame->duration, stream->time_base, AVRational{ 1, 1000000 }) : frame_duration_us;
+	slot->Serial = DecodeSerial;
+	slot->PacketSerial = d.PacketSerial;
+	slot->EndOfStream = false;
+	slot->Context = Context.get();
+
+	if (convertDecodedVideoFrame(this, d.Frame, slot, true) == VideoPlayerErrorCode::kErrorCode_Success) {
+		VideoFrames.Push();
+	}
+	av_frame_unref(d.Frame);
+	d.HasFrame = false;
+	return true;
+}
+
+/* -----------------------
+   Present step
+   ----------------------- */
+
+/*
+  呈现队首帧。返回 true 表示处理了一帧（呈现或丢弃）；
+  返回 false 时 wait_us 为距队首帧到期的微秒数，-1 表示在等待输入或状态变化。
+*/
+bool VideoPlayer::PresentOnce(bool block, int64_t* wait_us)
+{
+	auto& p = Presenter;
+	*wait_us = -1;
+
+	QueuedFrame* slot = VideoFrames.PeekReadable(block);
+	if (!slot) {
+		return false;
+	}
+
+	if (slot->PacketSerial != VideoPackets.Serial()) {
+		// seek 之前解码的帧，直接丢弃
+		NextFrame();
+		return true;
+	}
+
+	if (slot->EndOfStream) {
+		NextFrame();
+		EndOfStream = true;
+		LogInfo("End of stream, presented frames: %lld", (long long)PresentedFrames.load());
+		if (Options.EndOfStreamCallback) {
+			Options.EndOfStreamCallback(UserData);
+		}
+		return true;
+	}
+
+	if (!IsRunning.load() || Scrubbing.load()) {
+		// 暂停 / 拖动：seek 之后的第一帧立即呈现作为预览，其余等待状态变化
+		p.FirstPtsUS = -1;
+		if (slot->Serial != p.Serial) {
+			p.Serial = slot->Serial;
+			CurrentTimeMills.store(FrameTimeMills(slot));
+			processDecodedVideoFrame(this, slot);
+			NextFrame();
+			return true;
+		}
+		if (block) {
+			std::unique_lock<std::mutex> lock(StateMutex);
+			uint64_t version = StateVersion;
+			StateCond.wait_for(lock, std::chrono::milliseconds(kCommandPollMills), [&] {
+				return StateVersion != version || !IsAlive.load();
+			});
+		}
+		return false;
+	}
+
+	if (Options.Offline) {
+		// 离线模式：不等待、不丢帧；拉取模式下等消费者取走上一帧（回调模式由回调本身阻塞形成背压）
+		if (Options.LatestFrameMailbox && LatestFrame.HasUnread()) {
+			if (block) {
+				av_usleep(kOfflinePollMills * 1000);
+			}
+			else {
+				*wait_us = kOfflinePollMills * 1000;
+			}
+			return false;
+		}
+		CurrentTimeMills.store(FrameTimeMills(slot));
+		PresentedFrames++;
+		processDecodedVideoFrame(this, slot);
+		NextFrame();
+		return true;
+	}
+
+	double current_rate = PlaybackRate.load();
+	if (p.FirstPtsUS < 0 || slot->Serial != p.Serial || current_rate != p.Rate) {
+		// 循环 / playlist 下一项：解码序列变化而包序列不变（没有 seek），帧所属的媒体变化表示切换到了下一项
+		bool continued = p.FirstPtsUS >= 0 && slot->Serial != p.Serial && slot->PacketSerial == p.PacketSerial;
+		bool next_item = continued && slot->Context != p.Context;
+		if (continued && !next_item) Loops++;
+		// 开始 / 恢复 / 循环 / seek / 变速之后重新对齐 wallclock；
+		// 无缝循环和 playlist 切换不重新对齐，下一段第一帧紧接上一段最后一帧的结束时间，时间线连续
+		bool gapless = continued && (Options.GaplessLoop || next_item) && current_rate == p.Rate && p.Direction > 0 && p.NextDueUS != AV_NOPTS_VALUE;
+		p.Serial = slot->Serial;
+		p.Rate = current_rate > 0 ? current_rate : 1.0;
+		p.FirstPtsUS = slot->PtsUS;
+		p.StartTimeUS = gapless ? p.NextDueUS : MonotonicNowUS();
+		p.Direction = Reverse.load() ? -1.0 : 1.0;
+
+		ClockPtsUS = p.FirstPtsUS;
+		ClockWallUS = p.StartTimeUS;
+		ClockRate = p.Rate;
+		ClockSerial = p.Serial;
+	}
+
+	// 主时钟不是视频时，视频时钟偏离主时钟超过阈值则平移视频时钟：
+	// 落后时后续帧走下面的丢帧逻辑，超前时当前画面保持更久（重复帧）
+	int64_t now_us = MonotonicNowUS();
+	int64_t master_us = MasterClockUS(now_us);
+	FFmpegContext* audio_context = AudioSwitchContext.load();
+	if (MasterClock == VIDEO_MASTER_CLOCK_AUDIO && audio_context && audio_context != slot->Context) {
+		// playlist 切换过渡期：音频时钟已经是另一项的时间
+		master_us = AV_NOPTS_VALUE;
+	}
+	if (master_us != AV_NOPTS_VALUE) {
+		int64_t video_us = p.FirstPtsUS + (int64_t)((now_us - p.StartTimeUS) * p.Rate);
+		int64_t drift_us = video_us - master_us;
+		AvSyncDriftUS = drift_us;
+		if (std::abs(drift_us) > kAvSyncThresholdUS && std::abs(drift_us) < kAvNoSyncThresholdUS) {
+			p.StartTimeUS += (int64_t)(drift_us / p.Rate);
+			ClockWallUS = p.StartTimeUS;
+			SyncCorrections++;
+			if (drift_us > 0 && slot->DurationUS > 0) {
+				RepeatedFrames += drift_us / slot->DurationUS;
+			}
+		}
+	}
+
+	// 视频应该显示的时间（wallclock） = (pts_us - first_pts_us) / rate + start_time_us
+	int64_t target_us = (int64_t)((slot->PtsUS - p.FirstPtsUS) * p.Direction / p.Rate) + p.StartTimeUS;
+	int64_t delay_us = target_us - now_us;
+
+	if (delay_us > 0) {
+		// 当前时间比目标时间早，等待（解码此时继续预解码），暂停 / seek 会打断等待
+		if (block) {
+			if (!WaitForPresentTime(target_us)) {
+				return false;
+			}
+		}
+		else if (delay_us > kScheduledPresentEarlyUS) {
+			// 共享调度器：把剩余时间交给调度器的定时唤醒，工作线程不能为一个播放器阻塞
+			*wait_us = delay_us;
+			return false;
+		}
+	}
+	else if (delay_us < -kLateFrameUS && VideoFrames.Size() > 1) {
+		// 当前落后超过 30ms 且后面还有帧，丢弃这一帧赶上
+		PresenterDroppedFrames++;
+		NextFrame();
+		return true;
+	}
+
+	// 更新 CurrentTimeMills
+	CurrentTimeMills.store(FrameTimeMills(slot));
+	PresentedFrames++;
+	Pacing.Add(MonotonicNowUS() - target_us);
+	p.PacketSerial = slot->PacketSerial;
+	p.NextDueUS = slot->DurationUS > 0 ? target_us + (int64_t)(slot->DurationUS / p.Rate) : AV_NOPTS_VALUE;
+
+	// 处理帧回调
+	processDecodedVideoFrame(this, slot);
+	NextFrame();
+	return true;
+}
+
+/* -----------------------
+   Host-driven present
+   ----------------------- */
+
+// 在调用线程上呈现覆盖 target_us 的帧（代替呈现线程），返回 false 表示超时
+bool VideoPlayer::PresentAt(int64_t target_us, int timeout_mills)
+{
+	auto& h = Host;
+	HostTargetUS = target_us;
+
+	bool has_current = h.PtsUS != AV_NOPTS_VALUE && h.Serial == VideoPackets.Serial();
+	if (has_current && target_us >= h.PtsUS && target_us < h.EndUS) {
+		// 时间推进很慢（慢放 / 暂停 / 高帧率宿主）：当前帧仍然有效
+		return true;
+	}
+
+	bool backward, far_ahead;
+	if (has_current) {
+		backward = target_us < h.PtsUS;
+		far_ahead = target_us - h.EndUS > kHostSeekAheadUS;
+	}
+	else {
+		// 还没有当前帧（刚打开 / seek 的帧尚未到达）：与解码器即将交付的位置比较，
+		// 依次为未完成的 seek 目标、队首的帧、最近一次 seek / 打开的位置
+		int64_t position_us;
+		QueuedFrame* head = VideoFrames.PeekReadable(false);
+		if (h.SeekTargetUS != AV_NOPTS_VALUE) {
+			position_us = h.SeekTargetUS;
+		}
+		else if (head && !head->EndOfStream && head->PacketSerial == VideoPackets.Serial()) {
+			position_us = head->PtsUS;
+		}
+		else {
+			position_us = CurrentTimeMills.load() * 1000 + StreamStartUS;
+		}
+		backward = target_us < position_us;
+		far_ahead = target_us - position_us > kHostSeekAheadUS;
+	}
+	if ((backward || far_ahead) && target_us != h.SeekTargetUS) {
+		// 解码器无法倒退，且大幅前跳时从关键帧解码更快
+		PlayerCommand command;
+		command.Type = PlayerCommandType::Seek;
+		command.Value = target_us - StreamStartUS;
+		int serial = VideoPackets.Serial();
+		if (PostCommand(command)) {
+			h.SeekTargetUS = target_us;
+			h.SeekSerial = serial;
+			h.PtsUS = h.EndUS = AV_NOPTS_VALUE;
+			has_current = false;
+		}
+	}
+
+	int64_t deadline_us = MonotonicNowUS() + (int64_t)std::max(0, timeout_mills) * 1000;
+	for (;;)
+	{
+		int remain_mills = (int)((deadline_us - MonotonicNowUS()) / 1000);
+		QueuedFrame* slot = VideoFrames.PeekReadableFor(remain_mills);
+		if (!slot) {
+			return false;
+		}
+
+		bool before_seek = h.SeekTargetUS != AV_NOPTS_VALUE && slot->PacketSerial == h.SeekSerial;
+		if (before_seek || slot->PacketSerial != VideoPackets.Serial()) {
+			// seek 之前解码的帧
+			NextFrame();
+			continue;
+		}
+
+		int64_t end_us = slot->PtsUS + std::max<int64_t>(slot->DurationUS, 1);
+		if (end_us <= target_us) {
+			// 宿主跳过的帧（解码器在请求更新前已转换）
+			PresenterDroppedFrames++;
+			NextFrame();
+			continue;
+		}
+
+		if (slot->PtsUS > target_us && has_current) {
+			// 目标落在当前帧和下一帧之间的空隙：保持当前帧直到下一帧开始
+			h.EndUS = slot->PtsUS;
+			return true;
+		}
+
+		// 覆盖目标时间的帧；seek 后落点晚于目标时呈现最近的帧
+		h.PtsUS = slot->PtsUS;
+		h.EndUS = end_us;
+		h.Serial = slot->PacketSerial;
+		h.SeekTargetUS = AV_NOPTS_VALUE;
+		CurrentTimeMills.store(FrameTimeMills(slot));
+		PresentedFrames++;
+		processDecodedVideoFrame(this, slot);
+		NextFrame();
+		return true;
+	}
+}
+
+/* -----------------------
+   Audio decode step
+   ----------------------- */
+
+// 解码音频并重采样为输出格式写入 AudioPcm；环形缓冲满时保留已转换数据，下次继续写入
+bool VideoPlayer::AudioDecodeOnce(bool block)
+{
+	auto& a = Audio;
+
+	if (a.Parked) {
+		// playlist 切换：解码器已排空，等待 demux 换入下一项
+		if (SwitchPending.load() && a.PacketSerial == SwitchAudioSerial.load()) {
+			if (block) av_usleep(kAudioPollMills * 1000);
+			return false;
+		}
+		a.Parked = false;
+	}
+	if (a.Generation != SwitchGeneration.load()) {
+		AdoptPlaylistAudio();
+	}
+
+	AVCodecContext* codecCtx = a.Codec;
+	if (!codecCtx) {
+		// 当前 playlist 项没有音频
+		if (block) av_usleep(kAudioPollMills * 1000);
+		return false;
+	}
+
+	if (a.PcmOffset < a.PcmSize) {
+		size_t written = AudioPcm.Write(a.Pcm.data() + a.PcmOffset, a.PcmSize - a.PcmOffset, AudioBytesPerFrame);
+		a.PcmOffset += written;
+		if (written > 0 && a.PcmEndPtsUS != AV_NOPTS_VALUE) {
+			int64_t pending_frames = (int64_t)((a.PcmSize - a.PcmOffset) / AudioBytesPerFrame);
+			AudioWrittenPtsUS = a.PcmEndPtsUS - pending_frames * 1000000 / AudioOutRate;
+		}
+		if (a.PcmOffset < a.PcmSize && written == 0) {
+			// 引擎音频线程消费前无法继续
+			if (block) av_usleep(kAudioPollMills * 1000);
+			return false;
+		}
+		return true;
+	}
+
+	int ret = avcodec_receive_frame(codecCtx, a.Frame);
+	if (ret == 0) {
+		int out_samples = swr_get_out_samples(Resampler, a.Frame->nb_samples);
+		size_t capacity = (size_t)std::max(out_samples, 0) * AudioBytesPerFrame;
+		if (a.Pcm.size() < capacity) {
+			a.Pcm.resize(capacity);
+		}
+		uint8_t* out = a.Pcm.data();
+		int converted = swr_convert(Resampler, &out, out_samples, (const uint8_t**)a.Frame->extended_data, a.Frame->nb_samples);
+		a.PcmOffset = 0;
+		a.PcmSize = converted > 0 ? (size_t)converted * AudioBytesPerFrame : 0;
+
+		// 没有时间戳的帧接在上一帧之后
+		int64_t pts = ff_get_best_effort_timestamp(a.Frame);
+		int64_t start_us = pts != AV_NOPTS_VALUE
+			? av_rescale_q(pts, a.Stream->time_base, AVRational{ 1, 1000000 })
+			: a.PcmEndPtsUS;
+		a.PcmEndPtsUS = start_us != AV_NOPTS_VALUE && converted > 0
+			? start_us + (int64_t)converted * 1000000 / AudioOutRate
+			: start_us;
+		av_frame_unref(a.Frame);
+		return true;
+	}
+
+	if (ret == AVERROR_EOF) {
+		avcodec_flush_buffers(codecCtx);
+		if (SwitchPending.load() && a.PacketSerial == SwitchAudioSerial.load()) {
+			a.Parked = true;
+			AudioDrained = true;
+		}
+		return true;
+	}
+
+	QueuedPacket item;
+	if (AudioPackets.Get(item, block) <= 0) {
+		return false;
+	}
+
+	if (item.Serial != a.PacketSerial) {
+		// seek：丢弃解码器、重采样器和环形缓冲中的旧数据
+		avcodec_flush_buffers(codecCtx);
+		swr_init(Resampler);
+		a.PacketSerial = item.Serial;
+		a.PcmOffset = a.PcmSize = 0;
+		a.PcmEndPtsUS = AV_NOPTS_VALUE;
+		AudioPcm.DiscardPending();
+		AudioWrittenPtsUS = AV_NOPTS_VALUE;
+	}
+
+	if (!item.Packet) {
+		avcodec_send_packet(codecCtx, nullptr);
+		return true;
+	}
+
+	avcodec_send_packet(codecCtx, item.Packet);
+	AudioPackets.Recycle(item.Packet);
+	return true;
+}
+
+// audio thread: 换到 playlist 当前项的音频解码器，输出格式不变，只按新的输入参数重建重采样器。
+// 排空超时时没有停下等待，上一项尚未写入的 PCM 直接丢弃
+void VideoPlayer::AdoptPlaylistAudio()
+{
+	auto& a = Audio;
+	a.Generation = SwitchGeneration.load();
+	a.Codec = Context->audioCodecContext;
+	a.Stream = Context->audioStream;
+	a.PcmOffset = a.PcmSize = 0;
+	a.PcmEndPtsUS = AV_NOPTS_VALUE;
+	AudioSwitchContext = Context.get();
+	AudioSwitchPos = AudioPcm.writePos.load();
+	if (a.Codec && !CreateResampler(a.Codec)) {
+		a.Codec = nullptr;
+		a.Stream = nullptr;
+	}
+}
+
+/* -----------------------
+   Dedicated threads
+   ----------------------- */
+void VideoPlayer::DemuxLoop()
+{
+	while (IsAlive.load()) {
+		DemuxOnce(true);
+	}
+}
+
+void VideoPlayer::LoopPlay()
+{
+	while (IsAlive.load()) {
+		DecodeOnce(true);
+	}
+}
+
+void VideoPlayer::PresentLoop()
+{
+	int64_t wait_us = 0;
+	while (IsAlive.load()) {
+		PresentOnce(true, &wait_us);
+	}
+}
+
+void VideoPlayer::AudioLoop()
+{
+	while (IsAlive.load()) {
+		AudioDecodeOnce(true);
+	}
+}
+
+/* -----------------------
+   Shared scheduler slice
+   ----------------------- */
+
+// 一个时间片：依次推进 demux / 解码 / 呈现直到没有进展，返回距下次需要运行的微秒数
+int64_t VideoPlayer::RunScheduledSlice()
+{
+	tlsSlicePlayer = this;
+	struct SliceScope { ~SliceScope() { tlsSlicePlayer = nullptr; } } scope;
+
+	for (int i = 0; i < kSchedulerSliceSteps; i++)
+	{
+		bool progress = DemuxOnce(false);
+		if (!IsAlive.load()) {
+			return -1;
+		}
+		progress |= DecodeOnce(false);
+		if (HasAudioOutput()) {
+			progress |= AudioDecodeOnce(false);
+		}
+
+		int64_t wait_us = -1;
+		if (!Options.HostDriven) {
+			progress |= PresentOnce(false, &wait_us);
+		}
+
+		if (!progress) {
+			// 按下一帧的呈现时间调度；等待输入 / 暂停时定期轮询，命令会立即唤醒
+			int64_t poll_us = kCommandPollMills * 1000;
+			return wait_us >= 0 ? std::min(wait_us, poll_us) : poll_us;
+		}
+	}
+	// 用完时间片，让出给其他播放器
+	return 0;
+}
+
+
+
+/* -----------------------
+   C API functions (Open/Close/Pause/Resume/Seek)
+   ----------------------- */
+
+VP_API VideoPlayer* CreateVideoPlayer(void* user_data) {
+	auto* player = new VideoPlayer();
+	player->UserData = user_data;
+	return player;
+}
+
+VP_API void DestroyVideoPlayer(VideoPlayer* player) {
+	if (player) {
+		Close(player);
+		delete player;
+	}
+}
+
+static bool IsOpenCancelled(VideoPlayer* player, const char* file)
+{
+	if (!player->OpenCancel.load()) return false;
+	LogInfo("Open cancelled: %s", file);
+	return true;
+}
+
+static std::unique_ptr<IVideoStream> CreateMediaStream(const char* file)
+{
+	if (strncmp(file, "fd://", 5) == 0) {
+		int fd = std::atoi(file + 5);
+		if (fd < 0) return nullptr;
+		LogInfo("Use file descriptor stream: %s", file);
+		return std::make_unique<VideoFileDescriptorStream>(fd);
+	}
+	LogInfo("Use file stream: %s", file);
+	return std::make_unique<VideoFileStream>(std::string(file));
+}
+
+// Open 与 playlist 预打开下一项共用：avio 已设置好的 ctx 从 avformat_open_input 一直到打开解码器
+static bool LoadMediaContext(VideoPlayer* player, FFmpegContext* ctx, const char* file, const VideoPlayerOptions& options, bool openAudio,
+	std::unique_ptr<ProbeCache>& probe, ProbeCacheEntry& probeInfo)
+{
+	ctx->avformatContext->pb = ctx->ioContext;
+	ctx->avformatContext->flags = AVFMT_FLAG_CUSTOM_IO;
+	ctx->avformatContext->interrupt_callback.callback = InterruptCallback;
+	ctx->avformatContext->interrupt_callback.opaque = player;
+
+	// 调用者提供的探测参数：减少探测读取的数据量 / 跳过格式探测，缩短首帧时间
+	if (options.ProbeSize > 0) {
+		ctx->avformatContext->probesize = options.ProbeSize;
+	}
+	if (options.AnalyzeDurationMills > 0) {
+		ctx->avformatContext->max_analyze_duration = options.AnalyzeDurationMills * 1000;
+	}
+	const AVInputFormat* input_format = nullptr;
+	if (options.FormatHint && options.FormatHint[0]) {
+		input_format = av_find_input_format(options.FormatHint);
+		if (!input_format) {
+			LogWarning("Unknown input format hint: %s", options.FormatHint);
+		}
+	}
+
+	RTN_FALSE_IF_UNZERO(avformat_open_input(&ctx->avformatContext, NULL, input_format, NULL), "avformat_open_input failed");
+
+	// 探测缓存命中时：mov/mp4、mkv 用缓存的流参数代替 avformat_find_stream_info（需要读包并解码），
+	// 其余格式仍以最小的探测量调用它建立 demuxer 内部的 parser 状态，缓存只提供解码测速和关键帧索引
+	bool is_fd = strncmp(file, "fd://", 5) == 0;
+	std::string cache_dir = (options.ProbeCacheDirectory && !is_fd) ? options.ProbeCacheDirectory : "";
+	probe = std::make_unique<ProbeCache>(cache_dir, is_fd ? std::string() : std::string(file));
+	probeInfo = ProbeCacheEntry();
+	bool probe_hit = probe->Load(probeInfo) && ProbeCache::Matches(probeInfo, ctx->avformatContext);
+	bool stream_info_cached = probe_hit && ProbeCache::CanSkipStreamInfo(ctx->avformatContext) && ProbeCache::Apply(probeInfo, ctx->avformatContext);
+	if (!stream_info_cached) {
+		if (probe_hit) {
+			ctx->avformatContext->probesize = std::min<int64_t>(ctx->avformatContext->probesize, kCachedProbeSize);
+			ctx->avformatContext->max_analyze_duration = kCachedAnalyzeDurationUS;
+		}
+		RTN_FALSE_IF_NEGATIVE(avformat_find_stream_info(ctx->avformatContext, NULL), "avformat_find_stream_info failed.");
+	}
+	if (probe_hit) {
+		LogInfo("Probe cache hit%s: %s", stream_info_cached ? "" : " (stream info probed)", file);
+		ctx->decoderFPS = probeInfo.DecoderFPS;
+		ctx->keyFrameGapTime = probeInfo.KeyFrameGapTime;
+		ctx->keyFrames.Load(probeInfo.KeyFrames, static_cast<KeyFrameIndexSource>(probeInfo.KeyFrameSource), probeInfo.KeyFramesComplete);
+	}
+	if (IsOpenCancelled(player, file)) return false;
+	
+	
+	// open codecs - using your helper functions in FFmpegContext
+	
+	// assume FFmpegContext provides methods to open streams:
+	// 共享调度器模式下由调度器在播放器之间并行，默认不再为每个解码器开线程
+	ctx->requestedThreadCount = (options.UseSharedScheduler && options.DecoderThreadCount == 0) ? 1 : options.DecoderThreadCount;
+	ctx->requestedThreadType = options.DecoderThreadType;
+	// 快速打开：不在调用线程上解码测速、读包估算关键帧间隔，解码速度在播放开始后统计
+	bool fast_open = options.FastOpen != 0;
+	if (!ctx->LoadVideoProperties(!probe_hit && !fast_open, !fast_open)) {
+		LogError("LoadVideoProperties failed");
+		return false;
+	}
+	if (IsOpenCancelled(player, file)) return false;
+
+	if (!probe_hit && probe->Enabled()) {
+		ProbeCache::Capture(ctx->avformatContext, probeInfo);
+		probeInfo.DecoderFPS = ctx->decoderFPS;
+		probeInfo.KeyFrameGapTime = ctx->keyFrameGapTime;
+		probeInfo.KeyFrameSource = (int)ctx->keyFrames.Source();
+		probeInfo.KeyFramesComplete = ctx->keyFrames.Complete();
+		probeInfo.KeyFrames = ctx->keyFrames.Snapshot();
+		probe->Save(probeInfo);
+	}
+
+	// open audio only if not muted
+	if (openAudio) {
+		// if fails, just continue without audio
+		(void)ctx->OpenAudioStream();
+	}
+	else {
+		ctx->audioStreamIdx = -1;
+	}
+	return true;
+}
+
+// 非 RGBA / BGRA 的源转换为 RGBA，同时填写 VideoInfo 中的像素格式
+static std::unique_ptr<FormatConverter> CreateFormatConverter(const FFmpegContext* ctx, VideoInfo& info, float frameScale)
+{
+	AVPixelFormat srcFmt = AV_PIX_FMT_RGBA;
+	AVPixelFormat dstFmt = srcFmt;
+	if (ctx->videoStream) {
+		auto* st = ctx->videoStream;
+		srcFmt = static_cast<AVPixelFormat>(st->codecpar->format);
+		dstFmt = srcFmt;
+		switch (st->codecpar->format) {
+		case AV_PIX_FMT_BGRA:
+			info.PixelFormat = VideoFrameFormat::VIDEO_FRAME_BGRA;
+			break;
+		case AV_PIX_FMT_RGBA:
+			info.PixelFormat = VideoFrameFormat::VIDEO_FRAME_RGBA;
+			break;
+		default:
+			info.PixelFormat = VideoFrameFormat::VIDEO_FRAME_RGBA;
+			dstFmt = AV_PIX_FMT_RGBA;
+			break;
+		}
+	}
+
+	return std::make_unique<FormatConverter>(
+		ctx->originWidth,
+		ctx->originHeight,
+		dstFmt,
+		frameScale);
+}
+
+static bool OpenInternal(VideoPlayer* player, const char* file, VideoPlayerOptions options)
+{
+	{
+		std::lock_guard<std::mutex> lock(player->Mutex);
+		if (player->Context) {
+			LogWarning("Video player already opened.");
+			return false;
+		}
+	}
+
+	// 打开 / 探测 / 打开解码器都不持有 Mutex，结果先放在局部变量里，GetVideoInfo 等接口不会被整个打开过程阻塞
+	std::unique_ptr<IVideoStream> io = CreateMediaStream(file);
+	if (!io) return false;
+
+	auto ctx = std::make_unique<FFmpegContext>();
+	ctx->avformatContext = avformat_alloc_context();
+
+	uint8_t* buffer = reinterpret_cast<uint8_t*>(av_malloc(kCustomIoBufferSize));
+	ctx->IoBufferSize = kCustomIoBufferSize;
+	ctx->ioContext = avio_alloc_context(
+		buffer,
+		ctx->IoBufferSize,
+		0,
+		io.get(),
+		MediaReadCallback,
+		nullptr,
+		MediaSeekCallback);
+
+	if (ctx->ioContext == nullptr) {
+		LogError("avio_alloc_context failed.");
+
+		if (buffer) {
+			av_free(buffer);
+		}
+		return false;
+	}
+
+	std::unique_ptr<ProbeCache> probe;
+	ProbeCacheEntry probe_info;
+	if (!LoadMediaContext(player, ctx.get(), file, options, !options.Mute, probe, probe_info)) {
+		return false;
+	}
+
+	// publish under lock; a cancelled open publishes nothing and never starts workers
+	{
+		std::lock_guard<std::mutex> lock(player->Mutex);
+		if (IsOpenCancelled(player, file)) return false;
+		if (player->Context) {
+			LogWarning("Video player already opened.");
+			return false;
 		}
 
+		player->Options = options;
+		player->IO = std::move(io);
+		player->Probe = std::move(probe);
+		player->ProbeInfo = std::move(probe_info);
 		player->Context = std::move(ctx);
+		if (player->Context->audioCodecContext && !player->SetupAudioOutput(options)) {
+			player->Context->audioStreamIdx = -1;
+		}
+		player->Context->DiscardUnusedStreams();
 
 
 
 		auto video_info = std::make_unique<VideoInfo>();
 		player->Context->FillVideoInfo(*video_info);
+		if (player->HasAudioOutput()) {
+			video_info->AudioChannels = player->AudioOutChannels;
+			video_info->AudioSampleRate = player->AudioOutRate;
+			video_info->AudioSampleFormat = player->AudioOutFormat == AV_SAMPLE_FMT_S16 ? VIDEO_AUDIO_SAMPLE_S16 : VIDEO_AUDIO_SAMPLE_FLOAT;
+		}
 		player->VideoInfo = std::move(video_info);
+		player->DecoderFPS = player->Context->decoderFPS;
 
-		AVPixelFormat srcFmt = AV_PIX_FMT_RGBA;
-		AVPixelFormat dstFmt = srcFmt;
-		if (player->Context->videoStream) {
-			auto* st = player->Context->videoStream;
-			srcFmt = static_cast<AVPixelFormat>(st->codecpar->format);
-			dstFmt = srcFmt;
-			switch (st->codecpar->format) {
-			case AV_PIX_FMT_BGRA:
-				player->VideoInfo->PixelFormat = VideoFrameFormat::VIDEO_FRAME_BGRA;
-				break;
-			case AV_PIX_FMT_RGBA:
-				player->VideoInfo->PixelFormat = VideoFrameFormat::VIDEO_FRAME_RGBA;
-				break;
-			default:
-				player->VideoInfo->PixelFormat = VideoFrameFormat::VIDEO_FRAME_RGBA;
-				dstFmt = AV_PIX_FMT_RGBA;
-				break;
-			}
+		player->MasterClock = options.MasterClock;
+		if (player->MasterClock == VIDEO_MASTER_CLOCK_AUTO) {
+			player->MasterClock = player->HasAudioOutput() ? VIDEO_MASTER_CLOCK_AUDIO : VIDEO_MASTER_CLOCK_VIDEO;
+		}
+		else if (player->MasterClock == VIDEO_MASTER_CLOCK_AUDIO && !player->HasAudioOutput()) {
+			LogWarning("Audio master clock requested without audio output, using video clock.");
+			player->MasterClock = VIDEO_MASTER_CLOCK_VIDEO;
 		}
+		player->AudioClock.Invalidate();
+		player->ExternalClock.Invalidate();
+		player->AudioWrittenPtsUS = AV_NOPTS_VALUE;
+		player->AudioPulled = false;
 
-		player->FormatConverter = std::make_unique<FormatConverter>(
-			player->Context->originWidth,
-			player->Context->originHeight,
-			dstFmt,
-			options.FrameScale);
+		player->FormatConverter = CreateFormatConverter(player->Context.get(), *player->VideoInfo, options.FrameScale);
 
 		// set initial playing time to 0
 		player->CurrentTimeMills.store(0);
 	}
 
-	// start worker thread (not holding lock)
+	// start worker threads (not holding lock)
 	{
 		std::lock_guard<std::mutex> lock(player->Mutex);
-		player->IsRunning = true;
-		player->Worker = std::thread(&VideoPlayer::LoopPlay, player);
+		auto* pctx = player->Context.get();
+		int64_t frameDurationUS = pctx->frameRate > 0 ? (int64_t)(1000000.0 / pctx->frameRate) : 0;
+		player->VideoPackets.Configure(
+			pctx->timebase,
+			frameDurationUS,
+			options.PacketQueueMaxBytes,
+			options.PacketQueueMaxMills * 1000);
+		player->VideoPackets.Flush();
+		if (player->HasAudioOutput()) {
+			player->AudioPackets.Configure(
+				player->Context->audioStream->time_base,
+				0,
+				options.PacketQueueMaxBytes,
+				options.PacketQueueMaxMills * 1000);
+			player->AudioPackets.Flush();
+		}
+		if (!player->VideoFrames.Init(options.FrameQueueSize)) {
+			LogError("Failed to allocate frame queue");
+			return false;
+		}
+		AVStream* st = pctx->videoStream;
+		player->StreamStartUS = (st->start_time != AV_NOPTS_VALUE) ? av_rescale_q(st->start_time, st->time_base, AVRational{ 1, 1000000 }) : 0;
+		player->DecodeSerial = 0;
+		player->ClockSerial = -1;
+		player->PresentedFrames = 0;
+		player->Pacing.Reset();
+		player->AvSyncDriftUS = 0;
+		player->HostTargetUS = AV_NOPTS_VALUE;
+		player->PlaybackRate = 1.0;
+		player->TrickPlay = false;
+		player->AccurateSeekUS = AV_NOPTS_VALUE;
+		player->SeekDiscardedFrames = 0;
+		player->CoalescedSeeks = 0;
+		player->Loops = 0;
+		player->Scrub = VideoPlayer::ScrubState();
+		player->Scrubbing = false;
+		player->Reverse = false;
+		player->ReverseStartUS = AV_NOPTS_VALUE;
+		player->ReverseDemux = VideoPlayer::ReverseDemuxState();
+		{
+			// 按字节上限换算帧数，初始容量取关键帧索引中最长的 GOP，扫描中的索引不完整时由缓存按需增长
+			const auto* converter = player->FormatConverter.get();
+			int64_t frame_bytes = std::max<int64_t>(1, (int64_t)converter->distWidth * converter->distHeight * 4);
+			int64_t max_bytes = options.ReverseCacheMaxBytes > 0 ? options.ReverseCacheMaxBytes : kDefaultReverseCacheMaxBytes;
+			int max_frames = (int)std::clamp<int64_t>(max_bytes / 2 / frame_bytes, 1, INT32_MAX);
+			int initial_frames = options.ReverseCacheFrames > 0
+				? options.ReverseCacheFrames
+				: std::max(kDefaultReverseCacheFrames, (int)player->Context->keyFrames.MaxGopSize());
+			for (auto& gop : player->ReverseGops) {
+				if (!gop.Init(initial_frames, max_frames)) {
+					LogError("Failed to allocate reverse frame cache");
+					return false;
+				}
+			}
+			LogDebug("Reverse cache: %d frames per GOP, up to %d (%lld MB total)", player->ReverseGops[0].Capacity(), max_frames, (long long)(max_bytes / (1024 * 1024)));
+		}
+		player->TrickPlayRate = options.TrickPlayRate > 0 ? std::clamp((double)options.TrickPlayRate, kMinPlaybackRate, kMaxPlaybackRate) : kDefaultTrickPlayRate;
+		player->DemuxEnded = false;
+		player->EndOfStream = false;
+		player->Host = VideoPlayer::HostState();
+		player->SyncCorrections = 0;
+		player->RepeatedFrames = 0;
+		player->PacingSpinUS = options.PacingSpinMicros == 0 ? kDefaultPacingSpinUS : std::max(0, options.PacingSpinMicros);
+		player->DecoderDroppedFrames = 0;
+		player->PresenterDroppedFrames = 0;
+		player->DecoderSkippedFrames = 0;
+		if (!player->StartWorkers(true, options.UseSharedScheduler != 0)) {
+			LogError("Failed to allocate decode state");
+			return false;
+		}
+
+		// 容器没有关键帧索引：后台单独打开文件扫描（只读包），fd 输入与播放共享读位置，无法并发扫描
+		player->IndexCancel = false;
+		if (!player->Context->keyFrames.Complete() && strncmp(file, "fd://", 5) != 0) {
+			// playlist 切换后 player->Context 换成下一项，扫描只针对打开时的这一项
+			FFmpegContext* ctx = player->Context.get();
+			player->IndexWorker = std::thread([player, ctx, path = std::string(file)]() {
+				KeyFrameIndex& index = ctx->keyFrames;
+				if (!ScanKeyFramesFromFile(path, ctx->videoStreamIdx, index, player->IndexCancel)) {
+					return;
+				}
+				std::lock_guard<std::mutex> lock(player->Mutex);
+				if (player->IndexCancel.load()) {
+					return;
+				}
+				int64_t gap_us = index.AverageGapUS();
+				if (gap_us > 0) {
+					ctx->keyFrameGapTime = av_rescale_q(gap_us, AVRational{ 1, 1000000 }, ctx->timebase);
+				}
+				if (player->Probe->Enabled()) {
+					// 下次打开不必再扫描
+					player->ProbeInfo.KeyFrameGapTime = ctx->keyFrameGapTime;
+					player->ProbeInfo.KeyFrameSource = (int)index.Source();
+					player->ProbeInfo.KeyFramesComplete = true;
+					player->ProbeInfo.KeyFrames = index.Snapshot();
+					player->Probe->Save(player->ProbeInfo);
+				}
+			});
+		}
 	}
 
+	// 启动之后才到达的取消由 Close 按正常流程停止工作线程
 	auto* pctx = player->Context.get();
-	LogInfo("Got video info, size: %lld * %lld, fps: %.2f, rotation: %d, codec: %s", pctx->actualFrameWidth, pctx->actualFrameHeight, pctx->frameRate, pctx->videoRotation, pctx->codecName.c_str());
+	LogInfo("Got video info, size: %lld * %lld, fps: %.2f, rotation: %d, codec: %s, decoder threads: %d", pctx->actualFrameWidth, pctx->actualFrameHeight, pctx->frameRate, pctx->videoRotation, pctx->codecName.c_str(), player->VideoInfo->DecoderThreadCount);
 	// notify video info callback outside lock
 	if (player->Options.VideoInfoCallback && player->VideoInfo) {
 		player->Options.VideoInfoCallback(player->VideoInfo.get(), player->UserData);
@@ -439,49 +2424,337 @@ VP_API bool Open(VideoPlayer* player, const char* file, VideoPlayerOptions optio
 	return true;
 }
 
+// playlist thread: 打开第 index 项并预读开头的包，失败返回 nullptr
+static std::unique_ptr<PlaylistMedia> PrepareMedia(VideoPlayer* player, int index, const std::string& file, const VideoPlayerOptions& options)
+{
+	int64_t start_us = MonotonicNowUS();
+	auto media = std::make_unique<PlaylistMedia>();
+	media->Index = index;
+	media->IO = CreateMediaStream(file.c_str());
+	if (!media->IO) return nullptr;
+
+	auto ctx = std::make_unique<FFmpegContext>();
+	ctx->avformatContext = avformat_alloc_context();
+
+	uint8_t* buffer = reinterpret_cast<uint8_t*>(av_malloc(kCustomIoBufferSize));
+	ctx->IoBufferSize = kCustomIoBufferSize;
+	ctx->ioContext = avio_alloc_context(
+		buffer,
+		ctx->IoBufferSize,
+		0,
+		media->IO.get(),
+		MediaReadCallback,
+		nullptr,
+		MediaSeekCallback);
+
+	if (ctx->ioContext == nullptr) {
+		LogError("avio_alloc_context failed.");
+
+		if (buffer) {
+			av_free(buffer);
+		}
+		return nullptr;
+	}
+
+	// 音频输出格式由第一项决定，后续项的音频重采样到同一格式；第一项没有音频时后续项也不输出音频
+	if (!LoadMediaContext(player, ctx.get(), file.c_str(), options, !options.Mute && player->HasAudioOutput(), media->Probe, media->ProbeInfo)) {
+		return nullptr;
+	}
+	ctx->DiscardUnusedStreams();
+
+	media->Info = std::make_unique<VideoInfo>();
+	ctx->FillVideoInfo(*media->Info);
+	if (ctx->audioCodecContext) {
+		media->Info->AudioChannels = player->AudioOutChannels;
+		media->Info->AudioSampleRate = player->AudioOutRate;
+		media->Info->AudioSampleFormat = player->AudioOutFormat == AV_SAMPLE_FMT_S16 ? VIDEO_AUDIO_SAMPLE_S16 : VIDEO_AUDIO_SAMPLE_FLOAT;
+	}
+	media->Converter = CreateFormatConverter(ctx.get(), *media->Info, options.FrameScale);
+
+	// 预读开头的包，切换时第一个 GOP 已经在内存中
+	AVPacket* packet = av_packet_alloc();
+	int video_packets = 0;
+	while (packet && video_packets < kPlaylistPrerollPackets && !player->OpenCancel.load())
+	{
+		if (av_read_frame(ctx->avformatContext, packet) < 0) {
+			break;
+		}
+		if (packet->stream_index != ctx->videoStreamIdx && packet->stream_index != ctx->audioStreamIdx) {
+			av_packet_unref(packet);
+			continue;
+		}
+		if (packet->stream_index == ctx->videoStreamIdx) {
+			video_packets++;
+		}
+		media->Preroll.push_back(packet);
+		packet = av_packet_alloc();
+	}
+	av_packet_free(&packet);
+
+	media->Context = std::move(ctx);
+	LogInfo("Playlist item %d prepared in %lld ms: %s", index, (long long)((MonotonicNowUS() - start_us) / 1000), file.c_str());
+	return media;
+}
+
+// 等待需要打开的下一项，并释放切换后已不再被引用的旧项
+void VideoPlayer::PlaylistLoop()
+{
+	for (;;)
+	{
+		std::vector<std::unique_ptr<PlaylistMedia>> expired;
+		int index = -1;
+		std::string file;
+		{
+			std::unique_lock<std::mutex> lock(PlaylistMutex);
+			PlaylistCond.wait(lock, [this] {
+				return !IsAlive.load() || Playlist.Retired.size() > kPlaylistRetiredItems || (Playlist.Preparing >= 0 && !Playlist.Next);
+			});
+			if (!IsAlive.load()) {
+				return;
+			}
+			while (Playlist.Retired.size() > kPlaylistRetiredItems) {
+				expired.push_back(std::move(Playlist.Retired.front()));
+				Playlist.Retired.pop_front();
+			}
+			if (Playlist.Preparing >= 0 && !Playlist.Next) {
+				index = Playlist.Preparing;
+				file = Playlist.Items[index];
+			}
+		}
+
+		if (!expired.empty()) {
+			// 关键帧扫描在第一次切换时已取消，释放第一项的上下文之前等扫描线程退出
+			std::thread scan;
+			{
+				std::lock_guard<std::mutex> lock(Mutex);
+				if (IndexCancel.load() && IndexWorker.joinable()) {
+					scan = std::move(IndexWorker);
+				}
+			}
+			if (scan.joinable()) {
+				scan.join();
+			}
+			expired.clear();
+		}
+		if (index < 0) {
+			continue;
+		}
+
+		VideoPlayerOptions options = Options;
+		options.ProbeCacheDirectory = Playlist.ProbeCacheDirectory.empty() ? nullptr : Playlist.ProbeCacheDirectory.c_str();
+		options.FormatHint = Playlist.FormatHint.empty() ? nullptr : Playlist.FormatHint.c_str();
+		auto media = PrepareMedia(this, index, file, options);
+
+		std::lock_guard<std::mutex> lock(PlaylistMutex);
+		if (!IsAlive.load()) {
+			return;
+		}
+		if (media) {
+			Playlist.Next = std::move(media);
+			Playlist.Preparing = -1;
+			Playlist.Failures = 0;
+		}
+		else {
+			// 跳过打不开的项；所有项都失败时当前项结束后停止
+			LogWarning("Playlist item %d could not be opened, skipped: %s", index, file.c_str());
+			Playlist.Failures++;
+			Playlist.Preparing = Playlist.Failures < (int)Playlist.Items.size() ? NextPlaylistIndex(index) : -1;
+		}
+	}
+}
+
+VP_API bool Open(VideoPlayer* player, const char* file, VideoPlayerOptions options)
+{
+	if (!player || !file) return false;
+	if (player->Opening.load()) {
+		LogWarning("Video player is opening asynchronously.");
+		return false;
+	}
+
+	player->OpenCancel = false;
+	return OpenInternal(player, file, options);
+}
+
+VP_API bool OpenPlaylist(VideoPlayer* player, const char* const* files, int32_t count, bool loop, VideoPlayerOptions options)
+{
+	if (!player || !files || count <= 0) return false;
+	if (options.HostDriven) {
+		LogWarning("Playlist is not supported in host-driven mode.");
+		return false;
+	}
+	if (player->Opening.load()) {
+		LogWarning("Video player is opening asynchronously.");
+		return false;
+	}
+	{
+		std::lock_guard<std::mutex> lock(player->Mutex);
+		if (player->Context) {
+			LogWarning("Video player already opened.");
+			return false;
+		}
+	}
+
+	std::string first;
+	{
+		std::lock_guard<std::mutex> lock(player->PlaylistMutex);
+		auto& list = player->Playlist;
+		list = VideoPlayer::PlaylistState();
+		for (int32_t i = 0; i < count; i++) {
+			if (!files[i]) {
+				LogError("Playlist item %d is null.", (int)i);
+				list = VideoPlayer::PlaylistState();
+				return false;
+			}
+			list.Items.emplace_back(files[i]);
+		}
+		list.Loop = loop;
+		list.ProbeCacheDirectory = options.ProbeCacheDirectory ? options.ProbeCacheDirectory : "";
+		list.FormatHint = options.FormatHint ? options.FormatHint : "";
+		list.Current = 0;
+		// 第一项打开之后后台线程立即开始打开下一项
+		list.Preparing = player->NextPlaylistIndex(0);
+		first = list.Items[0];
+	}
+	player->PlaylistIndex = 0;
+	player->PlaylistFinished = false;
+
+	player->OpenCancel = false;
+	if (!OpenInternal(player, first.c_str(), options)) {
+		if (!player->IsAlive.load()) {
+			std::lock_guard<std::mutex> lock(player->PlaylistMutex);
+			player->Playlist = VideoPlayer::PlaylistState();
+		}
+		return false;
+	}
+
+	{
+		// 后台线程启动之前不会发生切换
+		std::lock_guard<std::mutex> lock(player->PlaylistMutex);
+		player->Playlist.CurrentContext = player->Context.get();
+	}
+	std::lock_guard<std::mutex> lock(player->Mutex);
+	player->PlaylistWorker = std::thread(&VideoPlayer::PlaylistLoop, player);
+	return true;
+}
+
+VP_API bool OpenAsync(VideoPlayer* player, const char* file, VideoPlayerOptions options, OpenedCallback on_opened)
+{
+	if (!player || !file) return false;
+
+	std::lock_guard<std::mutex> lock(player->OpenMutex);
+	if (player->Opening.load()) {
+		LogWarning("Video player is opening asynchronously.");
+		return false;
+	}
+	if (player->OpenWorker.joinable()) {
+		// 上一次异步打开已经结束
+		player->OpenWorker.join();
+	}
+
+	player->OpenCancel = false;
+	player->Opening = true;
+	// 调用者的字符串在返回后可能失效，拷贝一份
+	std::string path(file);
+	std::string cache_dir = options.ProbeCacheDirectory ? options.ProbeCacheDirectory : "";
+	std::string format_hint = options.FormatHint ? options.FormatHint : "";
+	player->OpenWorker = std::thread([player, path, cache_dir, format_hint, options, on_opened]() mutable {
+		options.ProbeCacheDirectory = cache_dir.empty() ? nullptr : cache_dir.c_str();
+		options.FormatHint = format_hint.empty() ? nullptr : format_hint.c_str();
+		bool ok = OpenInternal(player, path.c_str(), options);
+		bool cancelled = player->OpenCancel.load();
+		player->Opening = false;
+		if (!cancelled && on_opened) {
+			on_opened(player, ok, player->UserData);
+		}
+	});
+	return true;
+}
+
 VP_API void Close(VideoPlayer* player)
 {
 	if (!player) return;
 
-	// stop thread and join outside lock to avoid deadlock
-	std::thread tmp = player->StopAndExtractWorker();
-	if (tmp.joinable()) tmp.join();
+	// 取消进行中的异步打开 / playlist 预打开：中断阻塞的 IO，等待打开线程结束后再按正常流程关闭
+	player->OpenCancel = true;
+	{
+		std::lock_guard<std::mutex> lock(player->OpenMutex);
+		if (player->OpenWorker.joinable()) {
+			if (player->OpenWorker.get_id() == std::this_thread::get_id()) {
+				// 在 on_opened 回调中关闭，打开线程即将结束
+				player->OpenWorker.detach();
+			}
+			else {
+				player->OpenWorker.join();
+			}
+		}
+	}
+
+	// ask the worker to exit after pending commands, fall back to stopping directly if the command queue is full
+	PlayerCommand command;
+	command.Type = PlayerCommandType::Close;
+	if (player->Scheduled || !player->IsAlive.load() || !player->PostCommand(command)) {
+		player->StopWorkers();
+	}
+
+	// join outside lock to avoid deadlock
+	if (player->Scheduled) {
+		DecodeScheduler::Shared().Remove(&player->Task);
+	}
+	auto workers = player->ExtractWorkers();
+	VideoPlayer::JoinWorkers(workers);
 
 	// now safe to free resources under lock
 	std::lock_guard<std::mutex> lock(player->Mutex);
 
+	// drop commands posted after Close
+	while (player->Commands.Pop(command)) {}
+
+	player->VideoPackets.Flush();
+	player->VideoFrames.Flush();
+	player->ReverseGops[0].Reset();
+	player->ReverseGops[1].Reset();
+	player->LatestFrame.Reset();
+	if (player->OutputBuffers) {
+		player->OutputBuffers->ReleaseAll();
+	}
+	player->AudioPackets.Flush();
+	player->FreePipelineState();
+	player->ReleaseAudioOutput();
+
 	player->FormatConverter.reset();
 	player->VideoInfo.reset();
-	player->IO.reset();
-
+	// avio 的 opaque 指向 IO，先关闭 Context
 	if (player->Context) {
 		player->Context.reset();
 	}
+	player->IO.reset();
+	player->Probe.reset();
+
+	{
+		std::lock_guard<std::mutex> playlist_lock(player->PlaylistMutex);
+		player->Playlist = VideoPlayer::PlaylistState();
+	}
+	player->PlaylistIndex = -1;
+	player->PlaylistFinished = false;
 }
 
 VP_API void Pause(VideoPlayer* player)
 {
-	if (!player) return;
+	if (!player || !player->IsAlive.load()) return;
 
-	// Stop the worker atomically and join outside lock
-	std::thread tmp = player->StopAndExtractWorker();
-	if (tmp.joinable()) tmp.join();
+	// non-blocking, the worker stops presenting while packets / frames keep buffering
+	PlayerCommand command;
+	command.Type = PlayerCommandType::Pause;
+	player->PostCommand(command);
 }
 
 VP_API bool Resume(VideoPlayer* player)
 {
-	if (!player || !player->Context) return false;
-
-	// start the worker only if it's not running
-	std::lock_guard<std::mutex> lock(player->Mutex);
-	if (player->IsRunning.load()) return false;
-
-	// adjust start wall clock so time continuity preserved
-	player->StartWallClockUS = av_gettime() - (player->CurrentTimeMills.load() * 1000);
+	if (!player || !player->IsAlive.load()) return false;
 
-	player->IsRunning = true;
-	player->Worker = std::thread(&VideoPlayer::LoopPlay, player);
-	return true;
+	PlayerCommand command;
+	command.Type = PlayerCommandType::Play;
+	return player->PostCommand(command);
 }
 
 VP_API bool IsRunning(VideoPlayer* player)
@@ -494,72 +2767,295 @@ VP_API int64_t GetPlayingMills(VideoPlayer* player)
 	return (player != nullptr) ? player->CurrentTimeMills.load() : 0;
 }
 
+VP_API bool GetVideoInfo(VideoPlayer* player, VideoInfo* out_info)
+{
+	if (!player || !out_info) return false;
+
+	std::lock_guard<std::mutex> lock(player->Mutex);
+	if (!player->VideoInfo) return false;
+
+	*out_info = *player->VideoInfo;
+	out_info->DecoderFPS = player->DecoderFPS.load();
+	return true;
+}
+
+// playlist 切换在 Mutex 下替换 Context，读取 Context 的接口都持有 Mutex
 VP_API int64_t GetDurationMills(VideoPlayer* player)
 {
-	return (player && player->Context) ? (int64_t)(player->Context->durationInSeconds * 1000) : 0;
+	if (!player) return 0;
+	std::lock_guard<std::mutex> lock(player->Mutex);
+	return player->Context ? (int64_t)(player->Context->durationInSeconds * 1000) : 0;
 }
 
 
 VP_API bool SeekToPercent(VideoPlayer* player, float percent)
 {
-	if (!player || !player->Context) return false;
+	if (!player || !player->IsAlive.load()) return false;
+
+	std::lock_guard<std::mutex> lock(player->Mutex);
+	if (!player->Context) return false;
 
 	percent = std::clamp(percent, 0.0f, 1.0f);
 
-	// stop worker and join (without holding the lock while joining)
-	std::thread tmp = player->StopAndExtractWorker();
-	if (tmp.joinable()) tmp.join();
+	AVFormatContext* fmt = player->Context->avformatContext;
+	int videoIndex = player->Context->videoStreamIdx;
+	if (!fmt || videoIndex < 0) {
+		return false;
+	}
 
-	// perform seek under lock to ensure exclusive access to context & codecs
-	{
-		std::lock_guard<std::mutex> lock(player->Mutex);
+	// duration is in AV_TIME_BASE units (microseconds)
+	int64_t duration = fmt->duration;
+	if (duration <= 0) {
+		// if duration not available, try stream duration
+		if (fmt->streams[videoIndex] && fmt->streams[videoIndex]->duration > 0)
+			duration = av_rescale_q(fmt->streams[videoIndex]->duration,
+				fmt->streams[videoIndex]->time_base, AV_TIME_BASE_Q);
+	}
+	if (duration <= 0) return false;
 
-		AVFormatContext* fmt = player->Context->avformatContext;
-		int videoIndex = player->Context->videoStreamIdx;
-		if (!fmt || videoIndex < 0) {
-			return false;
-		}
+	// non-blocking, the seek is executed on the demux thread
+	PlayerCommand command;
+	command.Type = PlayerCommandType::Seek;
+	command.Value = (int64_t)((double)duration * percent);
+	return player->PostCommand(command);
+}
 
-		// duration is in AV_TIME_BASE units (microseconds)
-		int64_t duration = fmt->duration;
-		if (duration <= 0) {
-			// if duration not available, try stream duration
-			if (fmt->streams[videoIndex] && fmt->streams[videoIndex]->duration > 0)
-				duration = av_rescale_q(fmt->streams[videoIndex]->duration,
-					fmt->streams[videoIndex]->time_base, AV_TIME_BASE_Q);
-		}
-		if (duration <= 0) return false;
+// 精确 seek：从目标之前的关键帧解码到目标帧，中间帧只解码不转换；调用者持有 Mutex
+static bool PostAccurateSeek(VideoPlayer* player, int64_t time_us)
+{
+	int64_t duration_us = (int64_t)(player->Context->durationInSeconds * 1000000.0);
+	PlayerCommand command;
+	command.Type = PlayerCommandType::Seek;
+	command.Value = std::clamp<int64_t>(time_us, 0, std::max<int64_t>(duration_us, 0));
+	command.Accurate = true;
+	return player->PostCommand(command);
+}
 
-		int64_t target_us = (int64_t)((double)duration * percent);
+VP_API bool SeekToMills(VideoPlayer* player, int64_t time_mills)
+{
+	if (!player || !player->IsAlive.load()) return false;
 
-		// flush decoders to drop any buffered frames
-		if (player->Context->videoCodecContext)
-			avcodec_flush_buffers(player->Context->videoCodecContext);
-		if (player->Context->audioCodecContext)
-			avcodec_flush_buffers(player->Context->audioCodecContext);
+	std::lock_guard<std::mutex> lock(player->Mutex);
+	if (!player->Context) return false;
+	return PostAccurateSeek(player, time_mills * 1000);
+}
 
-		// seek by global timestamp (AV_TIME_BASE units)
-		int ret = av_seek_frame(fmt, -1, target_us, AVSEEK_FLAG_BACKWARD);
-		if (ret < 0) {
-			LogError("Seek failed: %s", getAvError(ret));
-			return false;
-		}
+VP_API bool SeekToFrame(VideoPlayer* player, int64_t frame_index)
+{
+	if (!player || !player->IsAlive.load()) return false;
 
-		// set current time millis
-		player->CurrentTimeMills.store(target_us / 1000);
+	std::lock_guard<std::mutex> lock(player->Mutex);
+	if (!player->Context) return false;
 
-		// reset wall clock baseline so LoopPlay uses correct timing on resume
-		player->StartWallClockUS = av_gettime() - target_us;
+	AVRational frame_rate = player->Context->videoStream->avg_frame_rate;
+	if (frame_rate.num <= 0 || frame_rate.den <= 0) {
+		LogWarning("SeekToFrame: unknown frame rate.");
+		return false;
 	}
 
-	// restart worker if needed
-	{
-		std::lock_guard<std::mutex> lock(player->Mutex);
-		if (!player->IsRunning.load()) {
-			player->IsRunning = true;
-			player->Worker = std::thread(&VideoPlayer::LoopPlay, player);
+	// 帧序号按平均帧率换算为时间，目标取该帧时间范围的中点，避免时间戳取整误差落到前一帧
+	AVRational frame_time = av_inv_q(frame_rate);
+	int64_t time_us = av_rescale_q(std::max<int64_t>(frame_index, 0), frame_time, AVRational{ 1, 1000000 });
+	time_us += av_rescale_q(1, frame_time, AVRational{ 1, 1000000 }) / 2;
+	return PostAccurateSeek(player, time_us);
+}
+
+VP_API bool SetScrubbing(VideoPlayer* player, bool scrubbing)
+{
+	if (!player || !player->IsAlive.load()) return false;
+
+	PlayerCommand command;
+	command.Type = PlayerCommandType::Scrub;
+	command.Value = scrubbing ? 1 : 0;
+	return player->PostCommand(command);
+}
+
+static void ToVideoKeyFrame(const KeyFrameEntry& entry, int64_t start_us, VideoKeyFrame* out)
+{
+	out->TimeUS = entry.PtsUS - start_us;
+	out->BytePosition = entry.Pos;
+	out->GopSize = entry.GopSize;
+}
+
+VP_API int32_t GetKeyFrameIndex(VideoPlayer* player, VideoKeyFrame* out_frames, int32_t capacity)
+{
+	if (!player) return 0;
+
+	std::lock_guard<std::mutex> lock(player->Mutex);
+	if (!player->Context) return 0;
+
+	const KeyFrameIndex& index = player->Context->keyFrames;
+	if (!out_frames || capacity <= 0) {
+		return (int32_t)index.Count();
+	}
+	std::vector<KeyFrameEntry> entries(capacity);
+	size_t total = index.Copy(entries.data(), entries.size());
+	size_t copied = std::min(total, entries.size());
+	for (size_t i = 0; i < copied; i++) {
+		ToVideoKeyFrame(entries[i], player->StreamStartUS, &out_frames[i]);
+	}
+	return (int32_t)total;
+}
+
+VP_API bool FindKeyFrame(VideoPlayer* player, int64_t time_us, VideoKeyFrame* out_frame)
+{
+	if (!player || !out_frame) return false;
+
+	std::lock_guard<std::mutex> lock(player->Mutex);
+	if (!player->Context) return false;
+
+	KeyFrameEntry entry;
+	if (!player->Context->keyFrames.Find(time_us + player->StreamStartUS, entry)) {
+		return false;
+	}
+	ToVideoKeyFrame(entry, player->StreamStartUS, out_frame);
+	return true;
+}
+
+VP_API bool IsKeyFrameIndexComplete(VideoPlayer* player)
+{
+	if (!player) return false;
+
+	std::lock_guard<std::mutex> lock(player->Mutex);
+	return player->Context && player->Context->keyFrames.Complete();
+}
+
+VP_API bool SetPlaybackRate(VideoPlayer* player, double rate)
+{
+	if (!player || !player->IsAlive.load() || !(rate > 0)) return false;
+
+	PlayerCommand command;
+	command.Type = PlayerCommandType::Rate;
+	command.Rate = std::clamp(rate, kMinPlaybackRate, kMaxPlaybackRate);
+	return player->PostCommand(command);
+}
+
+VP_API bool SetReversePlayback(VideoPlayer* player, bool reverse)
+{
+	if (!player || !player->IsAlive.load()) return false;
+
+	PlayerCommand command;
+	command.Type = PlayerCommandType::Reverse;
+	command.Value = reverse ? 1 : 0;
+	return player->PostCommand(command);
+}
+
+VP_API bool GetPlaybackStats(VideoPlayer* player, VideoPlaybackStats* out_stats)
+{
+	if (!player || !out_stats) return false;
+
+	out_stats->PresentedFrames = player->PresentedFrames.load();
+	out_stats->DecoderDroppedFrames = player->DecoderDroppedFrames.load();
+	out_stats->PresenterDroppedFrames = player->PresenterDroppedFrames.load();
+	out_stats->DecoderSkippedFrames = player->DecoderSkippedFrames.load();
+	out_stats->CatchUpLevel = player->CurrentCatchUpLevel.load();
+	out_stats->OnTimeFrames = player->Pacing.OnTime.load();
+	out_stats->PacingJitterAvgUS = player->Pacing.AverageAbsErrorUS();
+	out_stats->PacingJitterMaxUS = player->Pacing.MaxAbsErrorUS.load();
+	out_stats->MasterClock = player->MasterClock;
+	out_stats->AvSyncDriftUS = player->AvSyncDriftUS.load();
+	out_stats->SyncCorrections = player->SyncCorrections.load();
+	out_stats->RepeatedFrames = player->RepeatedFrames.load();
+	out_stats->TrickPlay = player->TrickPlay.load() ? 1 : 0;
+	out_stats->Reverse = player->Reverse.load() ? 1 : 0;
+	out_stats->SeekDiscardedFrames = player->SeekDiscardedFrames.load();
+	out_stats->CoalescedSeeks = player->CoalescedSeeks.load();
+	out_stats->Loops = player->Loops.load();
+	return true;
+}
+
+VP_API VideoFrame* AcquireLatestFrame(VideoPlayer* player)
+{
+	if (!player || !player->Options.LatestFrameMailbox) return nullptr;
+	return player->LatestFrame.Acquire();
+}
+
+VP_API void ReleaseFrame(VideoPlayer* player, VideoFrame* frame)
+{
+	if (!player || !frame) return;
+	player->LatestFrame.Release(frame);
+}
+
+VP_API bool RegisterOutputBuffers(VideoPlayer* player, uint8_t* const* buffers, int32_t count, int32_t pitch, int32_t height)
+{
+	if (!player) return false;
+	if (buffers && count > 0) {
+		if (pitch <= 0 || height <= 0) return false;
+		for (int32_t i = 0; i < count; i++) {
+			if (!buffers[i]) return false;
 		}
 	}
 
+	std::lock_guard<std::mutex> lock(player->Mutex);
+	if (player->IsAlive.load() || player->Opening.load()) {
+		LogWarning("Output buffers can only be registered while the player is closed.");
+		return false;
+	}
+	if (!buffers || count <= 0) {
+		player->OutputBuffers.reset();
+		return true;
+	}
+	player->OutputBuffers = std::make_unique<OutputBufferSet>(buffers, count, pitch, height);
 	return true;
 }
+
+VP_API bool ReleaseOutputBuffer(VideoPlayer* player, int32_t index)
+{
+	if (!player || !player->OutputBuffers) return false;
+	return player->OutputBuffers->Release(index);
+}
+
+VP_API int32_t ReadAudioSamples(VideoPlayer* player, uint8_t* out_samples, int32_t frame_count)
+{
+	if (!player || !out_samples || frame_count <= 0) return 0;
+
+	int bytes_per_frame = player->AudioBytesPerFrame;
+	if (bytes_per_frame <= 0) return 0;
+	// 暂停时也算在拉取音频：demux 从此等待音频队列的空间
+	player->AudioPulled = true;
+	if (!player->IsRunning.load()) return 0;
+
+	size_t bytes = player->AudioPcm.Read(out_samples, (size_t)frame_count * bytes_per_frame, bytes_per_frame);
+
+	// 音频时钟：刚读出的第一个采样即将播放，其 pts = 已写入末尾 pts - 缓冲中剩余 - 本次读出
+	int64_t written_pts_us = player->AudioWrittenPtsUS.load();
+	if (written_pts_us == AV_NOPTS_VALUE) {
+		player->AudioClock.Invalidate();
+	}
+	else if (bytes > 0 && player->AudioPcm.readPos.load() - bytes < player->AudioSwitchPos.load()) {
+		// playlist 切换后仍在播放上一项的 PCM，写入末尾的 pts 已经属于下一项
+		player->AudioClock.Invalidate();
+	}
+	else if (bytes > 0) {
+		int64_t frames = (int64_t)((player->AudioPcm.AvailableToRead() + bytes) / bytes_per_frame);
+		player->AudioClock.Set(written_pts_us - frames * 1000000 / player->AudioOutRate, MonotonicNowUS(), 1.0);
+	}
+	return (int32_t)(bytes / bytes_per_frame);
+}
+
+VP_API bool RequestFrameAt(VideoPlayer* player, int64_t time_us, int32_t timeout_mills)
+{
+	if (!player || !player->IsAlive.load() || !player->Options.HostDriven) return false;
+	return player->PresentAt(time_us + player->StreamStartUS, timeout_mills);
+}
+
+VP_API int32_t GetPlaylistIndex(VideoPlayer* player)
+{
+	return player ? player->PlaylistIndex.load() : -1;
+}
+
+VP_API bool IsEndOfStream(VideoPlayer* player)
+{
+	return player && player->EndOfStream.load();
+}
+
+VP_API void SetExternalClock(VideoPlayer* player, int64_t time_mills)
+{
+	if (!player) return;
+	player->ExternalClock.Set(time_mills * 1000 + player->StreamStartUS, MonotonicNowUS(), player->PlaybackRate.load());
+}
+
+VP_API bool ConfigureDecodeScheduler(int32_t thread_count)
+{
+	return DecodeScheduler::Shared().Configure(thread_count);
+}
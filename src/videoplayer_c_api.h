@@ -39,9 +39,30 @@ extern "C" {
         VIDEO_FRAME_BGRA
     } VideoFrameFormat;
 
+    typedef enum VideoDecoderThreadType {
+        VIDEO_DECODER_THREAD_AUTO = 0,   // 根据 CPU 核数、分辨率和解码器能力自动选择
+        VIDEO_DECODER_THREAD_FRAME,      // 帧级多线程：吞吐高，延迟多 thread_count - 1 帧
+        VIDEO_DECODER_THREAD_SLICE,      // 片级多线程：低延迟，依赖码流的 slice 划分
+        VIDEO_DECODER_THREAD_NONE        // 单线程解码
+    } VideoDecoderThreadType;
+
+    typedef enum VideoAudioSampleFormat {
+        VIDEO_AUDIO_SAMPLE_FLOAT = 0,    // 32 位浮点，交错存储
+        VIDEO_AUDIO_SAMPLE_S16           // 16 位整数，交错存储
+    } VideoAudioSampleFormat;
+
+    typedef enum VideoMasterClock {
+        VIDEO_MASTER_CLOCK_AUTO = 0,     // 有音频输出时跟随音频，否则视频
+        VIDEO_MASTER_CLOCK_AUDIO,        // 跟随 ReadAudioSamples 的播放位置（仅 1x 速率）
+        VIDEO_MASTER_CLOCK_VIDEO,        // 视频按 PTS 自由运行
+        VIDEO_MASTER_CLOCK_EXTERNAL      // 跟随 SetExternalClock 提供的时间
+    } VideoMasterClock;
+
     typedef void (*VideoPlayerLogCallback)(VideoPlayerLogLevel level, const char* msg);
     typedef void (*AvInfoCallback)(const struct VideoInfo* info, void* user_data);
     typedef void (*FrameCallback)(VideoFrame* frame, void* user_data);
+    typedef void (*EndOfStreamCallback)(void* user_data);
+    typedef void (*OpenedCallback)(VideoPlayer* player, bool success, void* user_data);
 
     typedef struct VideoInfo {
         int64_t  DurationMills;
@@ -53,9 +74,12 @@ extern "C" {
         float    Fps;
         char     VideoCodec[64];  
         int32_t  Rotation;
-        double   DecoderFPS;
+        double   DecoderFPS;      // FastOpen 时为 0，播放开始后由 GetVideoInfo 返回测得的值
         uint8_t  HasAudio;        // 0/1
         VideoFrameFormat PixelFormat;
+        int32_t  DecoderThreadCount;             // 实际生效的解码线程数
+        VideoDecoderThreadType DecoderThreadType; // 实际生效的线程模式（FRAME / SLICE / NONE）
+        VideoAudioSampleFormat AudioSampleFormat; // ReadAudioSamples 输出格式，AudioChannels / AudioSampleRate 同为输出参数
     } VideoInfo;
 
     typedef struct VideoFrameInfo {
@@ -66,12 +90,63 @@ extern "C" {
         VideoFrameFormat Format; // RGBA / BGRA / unknown
     } VideoFrameInfo;
 
+    typedef struct VideoKeyFrame {
+        int64_t TimeUS;        // 相对流开始的时间（微秒）
+        int64_t BytePosition;  // 包在文件中的字节位置，未知为 -1
+        int32_t GopSize;       // 到下一个关键帧之前的帧数，未知为 0
+    } VideoKeyFrame;
+
+    typedef struct VideoPlaybackStats {
+        int64_t PresentedFrames;
+        int64_t DecoderDroppedFrames;   // 解码后因落后被丢弃（未转换、未回调）
+        int64_t PresenterDroppedFrames; // 已转换但呈现时已过期被丢弃
+        int64_t DecoderSkippedFrames;   // 追帧期间解码器 skip_frame 丢弃的帧（估算）
+        int32_t CatchUpLevel;           // 0 正常，1 丢弃非参考帧，2 只解关键帧
+        int64_t OnTimeFrames;           // 呈现误差在 ±0.5ms 内的帧数
+        int64_t PacingJitterAvgUS;      // 实际呈现时间与 PTS 目标时间的平均绝对误差（微秒）
+        int64_t PacingJitterMaxUS;      // 最大绝对误差（微秒）
+        VideoMasterClock MasterClock;   // 实际生效的主时钟
+        int64_t AvSyncDriftUS;          // 最近一次视频时钟相对主时钟的偏差，正数表示视频超前
+        int64_t SyncCorrections;        // 偏差超过阈值时视频时钟的校正次数
+        int64_t RepeatedFrames;         // 视频超前被校正时多显示的帧数（估算）
+        int32_t TrickPlay;              // 1 表示当前速率下只解码关键帧
+        int32_t Reverse;                // 1 表示正在倒放
+        int64_t SeekDiscardedFrames;    // 精确 seek 时从关键帧解码到目标帧之间丢弃的帧（未转换）
+        int64_t CoalescedSeeks;         // 被后续 seek 覆盖而没有执行的 seek 数
+        int64_t Loops;                  // 循环播放回到开头的次数
+    } VideoPlaybackStats;
+
     typedef struct VideoPlayerOptions {
         uint8_t Mute;            // 0/1
         int64_t StartMills;
         float   FrameScale;
         AvInfoCallback VideoInfoCallback;
         FrameCallback  FrameCallback;
+        int64_t PacketQueueMaxBytes;  // demux 预读缓冲上限（字节），0 使用默认值
+        int64_t PacketQueueMaxMills;  // demux 预读缓冲上限（时长），0 使用默认值
+        int32_t FrameQueueSize;       // 解码预取帧数（已转换），0 使用默认值
+        uint8_t LatestFrameMailbox;   // 0/1 启用 AcquireLatestFrame 拉取模式
+        int32_t DecoderThreadCount;   // 解码线程数上限，0 自动
+        VideoDecoderThreadType DecoderThreadType;
+        uint8_t UseSharedScheduler;   // 0/1 由进程级共享调度器驱动，而不是每个播放器 3 个线程
+        int32_t PacingSpinMicros;     // 呈现 deadline 前自旋等待的时长（微秒），0 使用默认值，负数关闭自旋
+        VideoAudioSampleFormat AudioSampleFormat; // ReadAudioSamples 输出采样格式
+        int32_t AudioSampleRate;      // 输出采样率，0 与源相同
+        int32_t AudioChannels;        // 输出声道数，0 与源相同
+        int32_t AudioBufferMills;     // PCM 环形缓冲时长，0 使用默认值
+        VideoMasterClock MasterClock; // A/V 同步的主时钟
+        uint8_t HostDriven;           // 0/1 由宿主通过 RequestFrameAt 驱动时间，不自行按墙钟呈现
+        uint8_t Offline;              // 0/1 离线批处理：不按时间呈现、不丢帧、不循环，全速解码并按顺序交付每一帧
+        EndOfStreamCallback EndOfStreamCallback; // 离线模式 / 不循环的 playlist 最后一帧交付之后调用（呈现线程）
+        float   TrickPlayRate;        // 播放速率达到该值后只解码关键帧，0 使用默认值（4x）
+        int32_t ReverseCacheFrames;   // 倒放时每个 GOP 缓存的初始帧数（共两个缓存），0 按关键帧索引的最长 GOP，GOP 更长时增长到 ReverseCacheMaxBytes
+        const char* ProbeCacheDirectory; // 探测结果缓存目录（UTF-8），NULL 关闭；按路径、大小和修改时间命中，fd:// 输入不使用
+        uint8_t FastOpen;             // 0/1 Open 时不解码测速、不读包估算关键帧间隔，解码速度在播放开始后统计
+        int64_t ProbeSize;            // 格式探测最多读取的字节数（probesize），0 使用 FFmpeg 默认值
+        int64_t AnalyzeDurationMills; // avformat_find_stream_info 最多分析的时长（analyzeduration），0 使用默认值
+        const char* FormatHint;       // 输入格式短名（如 "mp4"、"matroska"、"mpegts"），跳过格式探测，NULL 自动
+        uint8_t GaplessLoop;          // 0/1 循环时下一轮第一帧紧接上一轮最后一帧（PTS + 时长），不按墙钟重新对齐
+        int64_t ReverseCacheMaxBytes; // 两个倒放缓存合计的像素内存上限（字节），0 使用默认值（1 GB）；超过时 GOP 最早的帧不显示
     } VideoPlayerOptions;
 
     // -----------------------------
@@ -89,16 +164,101 @@ extern "C" {
     // frame helpers
     VP_API void GetFrameInfo(const VideoFrame* frame, VideoFrameInfo* out_info); 
     VP_API void GetFrameData(const VideoFrame* frame, uint8_t* dist_data);
+    // 未旋转的原始像素（只读），在帧被释放前有效
+    VP_API const uint8_t* GetFramePixels(const VideoFrame* frame, int32_t* out_pitch);
+    // RegisterOutputBuffers 注册的缓冲中存放该帧像素的下标，-1 表示帧在内部缓冲中（用 GetFrameData / GetFramePixels）
+    VP_API int32_t GetFrameOutputBuffer(const VideoFrame* frame);
 
-    // player control
+    // player control, Pause/Resume/SeekToPercent/SetPlaybackRate are non-blocking
     VP_API bool Open(VideoPlayer* player, const char* file_or_fd_uri, VideoPlayerOptions options);
+    // opens on a background thread, VideoInfoCallback and on_opened run on that thread once the player is ready
+    // (on_opened also reports failures). Close / DestroyVideoPlayer cancel an open in progress, interrupting
+    // blocking IO; on_opened is not called for a cancelled open. returns false if an open is already in progress.
+    VP_API bool OpenAsync(VideoPlayer* player, const char* file_or_fd_uri, VideoPlayerOptions options, OpenedCallback on_opened);
+    // plays count items in order (the first one is opened like Open). while an item plays the next one is opened,
+    // probed and pre-read on a background thread, and swapped in when the current item ends: its first frame follows
+    // the last frame of the previous item without a gap. VideoInfoCallback runs again for every item (demux thread).
+    // seeks stay within the current item; items that fail to open are skipped. without loop the player ends after
+    // the last item like offline mode (EndOfStreamCallback, IsEndOfStream). not supported with HostDriven.
+    VP_API bool OpenPlaylist(VideoPlayer* player, const char* const* files_or_fd_uris, int32_t count, bool loop, VideoPlayerOptions options);
+    // index of the playlist item being presented, -1 when not playing a playlist
+    VP_API int32_t GetPlaylistIndex(VideoPlayer* player);
     VP_API void Close(VideoPlayer* player);
     VP_API void Pause(VideoPlayer* player);
     VP_API bool Resume(VideoPlayer* player);
     VP_API bool IsRunning(VideoPlayer* player);
     VP_API int64_t GetPlayingMills(VideoPlayer* player);
     VP_API int64_t GetDurationMills(VideoPlayer* player);
+    // copy of the info passed to VideoInfoCallback, DecoderFPS is filled in once measured (FastOpen)
+    VP_API bool GetVideoInfo(VideoPlayer* player, VideoInfo* out_info);
+    // SeekToPercent lands on the nearest preceding keyframe (fast)
     VP_API bool SeekToPercent(VideoPlayer* player, float percent);
+    // frame-accurate seeks: decode forward from the preceding keyframe, the frames before the target are
+    // decoded but never converted or delivered. time_mills is relative to the stream start.
+    VP_API bool SeekToMills(VideoPlayer* player, int64_t time_mills);
+    // frame_index is zero based and converted to time with the average frame rate
+    VP_API bool SeekToFrame(VideoPlayer* player, int64_t frame_index);
+    // scrubbing mode for timeline dragging: queued seeks collapse to the latest target, each seek shows the
+    // nearest preceding keyframe immediately and playback holds on it. the frame-accurate position is decoded
+    // once no seek arrived for 150ms, or right away when scrubbing ends; playback resumes from there.
+    VP_API bool SetScrubbing(VideoPlayer* player, bool scrubbing);
+
+    // key frame index of the video stream. built at Open from the container index (mp4 stss, mkv cues ...),
+    // otherwise by a background packet scan (no decoding) that fills it progressively; fd:// inputs without a
+    // container index have none. GetKeyFrameIndex copies up to capacity entries and returns the total count
+    // (pass NULL to query the count). FindKeyFrame returns the last key frame at or before time_us.
+    VP_API int32_t GetKeyFrameIndex(VideoPlayer* player, VideoKeyFrame* out_frames, int32_t capacity);
+    VP_API bool FindKeyFrame(VideoPlayer* player, int64_t time_us, VideoKeyFrame* out_frame);
+    VP_API bool IsKeyFrameIndexComplete(VideoPlayer* player);
+    // rate is clamped to [0.1, 32], rates at or above TrickPlayRate show keyframes only
+    VP_API bool SetPlaybackRate(VideoPlayer* player, double rate);
+    // reverse playback from the current position, the playback rate still applies. loops to the end at the start.
+    VP_API bool SetReversePlayback(VideoPlayer* player, bool reverse);
+    VP_API bool GetPlaybackStats(VideoPlayer* player, VideoPlaybackStats* out_stats);
+
+    // pull mode (requires LatestFrameMailbox), single consumer thread only.
+    // returns the newest frame published since the last call, or NULL if nothing new;
+    // the frame stays valid until the next AcquireLatestFrame/ReleaseFrame/Close.
+    VP_API VideoFrame* AcquireLatestFrame(VideoPlayer* player);
+    VP_API void ReleaseFrame(VideoPlayer* player, VideoFrame* frame);
+
+    // caller-provided output memory (e.g. persistently mapped upload buffers), each holding height rows of pitch bytes.
+    // the decode thread scales / converts straight into them, so GetFrameOutputBuffer reports the index to upload
+    // and no GetFrameData copy is needed. once a frame is delivered (FrameCallback / mailbox) its buffer belongs to the
+    // caller until ReleaseOutputBuffer, even after the frame itself is released, so uploads can finish asynchronously.
+    // released buffers are reused round-robin in release order; with fewer than FrameQueueSize + 4 buffers plus the
+    // ones the caller holds some frames fall back. rotated videos, frames that need no conversion, frames larger than
+    // pitch x height, reverse playback, and frames decoded while every buffer is in use fall back to internal buffers
+    // (index -1). only while the player is closed (before Open / after Close); the registration is kept across
+    // Open / Close and the memory must stay valid while the player is open.
+    // NULL / count 0 unregisters.
+    VP_API bool RegisterOutputBuffers(VideoPlayer* player, uint8_t* const* buffers, int32_t count, int32_t pitch, int32_t height);
+    // hands a delivered buffer back once the caller no longer reads it, Close releases all of them.
+    // returns false for an index that is not held by the caller.
+    VP_API bool ReleaseOutputBuffer(VideoPlayer* player, int32_t index);
+
+    // audio pull (engine audio thread), copies up to frame_count interleaved sample frames in the
+    // output format reported by VideoInfo, returns the frames copied (0 while paused or starving).
+    // lock-free and allocation-free, must not race with Open / Close.
+    VP_API int32_t ReadAudioSamples(VideoPlayer* player, uint8_t* out_samples, int32_t frame_count);
+
+    // host-driven mode (HostDriven), time_us is relative to the stream start.
+    // delivers the frame covering time_us through FrameCallback / the mailbox, waiting up to timeout_mills for it
+    // to be decoded. returns true when that frame is current (including when it was delivered by an earlier call),
+    // false on timeout. backward or far forward jumps seek; frames the host skips over are never converted.
+    // single host thread only.
+    VP_API bool RequestFrameAt(VideoPlayer* player, int64_t time_us, int32_t timeout_mills);
+
+    // offline mode: true after the last frame was delivered, cleared by a seek.
+    VP_API bool IsEndOfStream(VideoPlayer* player);
+
+    // external master clock (VIDEO_MASTER_CLOCK_EXTERNAL), time is relative to the stream start like GetPlayingMills.
+    // the clock keeps running at the playback rate between calls.
+    VP_API void SetExternalClock(VideoPlayer* player, int64_t time_mills);
+
+    // shared scheduler (UseSharedScheduler), thread_count 0 uses the CPU core count.
+    // only effective before the first player using the scheduler is opened.
+    VP_API bool ConfigureDecodeScheduler(int32_t thread_count);
 
 #ifdef __cplusplus
 } // extern "C"